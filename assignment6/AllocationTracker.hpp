@@ -0,0 +1,356 @@
+#ifndef ALLOCATION_TRACKER_H_
+#define ALLOCATION_TRACKER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+
+
+namespace GLOO {
+    // Opt-in heap allocation accounting. Building with GLOO_TRACK_ALLOCATIONS
+    // defined replaces the global operator new/delete (in the one translation
+    // unit that also defines GLOO_ALLOCATION_TRACKER_IMPLEMENTATION) with
+    // versions that count every allocation and its size. Without it, the
+    // GLOO_ALLOCATION_PHASE macros compile to nothing.
+    //
+    // Phases are named scopes on the hot paths. Each scope adds the
+    // allocations made while it was open (by any thread, so the solver's
+    // ParallelFor chunks count too) to its phase; nested phases are included
+    // in their parents. Attribution assumes one simulation runs at a time;
+    // the totals are exact regardless. EndFrame closes a frame, keeping each
+    // phase's count for that frame and the worst frame seen.
+    //
+    // A "forbidding" phase (GLOO_FORBID_ALLOCATIONS) reports every allocation
+    // made while it is open as a violation, and aborts on the spot when
+    // GLOO_ALLOCATION_ABORT is set in the environment so a debugger shows the
+    // culprit. tools/allocation_check uses this to fail when the steady-state
+    // step loop allocates.
+    struct AllocationCounts {
+        uint64_t allocations = 0;
+        uint64_t bytes = 0;
+    };
+
+    class AllocationTracker {
+    public:
+        struct Phase {
+            const char* name = nullptr;
+            uint64_t calls = 0;
+            AllocationCounts total;
+            AllocationCounts frame; // the frame in progress
+            AllocationCounts last_frame;
+            AllocationCounts worst_frame;
+        };
+
+        static const int kMaxPhases = 32;
+
+        static AllocationTracker& GetInstance() {
+            static AllocationTracker tracker;
+            return tracker;
+        }
+
+        // Called by the operator new hook.
+        static void CountAllocation(size_t bytes) {
+            Counters().allocations.fetch_add(1, std::memory_order_relaxed);
+            Counters().bytes.fetch_add(bytes, std::memory_order_relaxed);
+            if (Counters().forbidding.load(std::memory_order_relaxed) > 0) {
+                Counters().violations.fetch_add(1, std::memory_order_relaxed);
+                if (std::getenv("GLOO_ALLOCATION_ABORT") != nullptr) {
+                    std::fputs("Allocation inside a phase that forbids allocations.\n", stderr);
+                    std::abort();
+                }
+            }
+        }
+
+        static bool IsEnabled() {
+#ifdef GLOO_TRACK_ALLOCATIONS
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        AllocationCounts GetTotals() const {
+            AllocationCounts counts;
+            counts.allocations = Counters().allocations.load(std::memory_order_relaxed);
+            counts.bytes = Counters().bytes.load(std::memory_order_relaxed);
+            return counts;
+        }
+        uint64_t GetViolations() const {
+            return Counters().violations.load(std::memory_order_relaxed);
+        }
+
+        void EnterForbidding() {
+            Counters().forbidding.fetch_add(1);
+        }
+        void ExitForbidding() {
+            Counters().forbidding.fetch_sub(1);
+        }
+
+        void RecordPhase(const char* name, const AllocationCounts& delta) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            Phase* phase = FindPhase(name);
+            if (phase == nullptr) {
+                return; // table full; the totals still count
+            }
+            phase->calls++;
+            Add(phase->total, delta);
+            Add(phase->frame, delta);
+        }
+
+        void EndFrame() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            AllocationCounts totals = GetTotals();
+            last_frame_.allocations = totals.allocations - frame_start_.allocations;
+            last_frame_.bytes = totals.bytes - frame_start_.bytes;
+            frame_start_ = totals;
+            for (int p = 0; p < phase_count_; p++) {
+                Phase& phase = phases_[p];
+                phase.last_frame = phase.frame;
+                if (phase.frame.allocations > phase.worst_frame.allocations) {
+                    phase.worst_frame = phase.frame;
+                }
+                phase.frame = AllocationCounts();
+            }
+            frame_count_++;
+        }
+
+        // Clears the phase statistics and violations (e.g. once warm-up is over).
+        void Reset() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int p = 0; p < phase_count_; p++) {
+                const char* name = phases_[p].name;
+                phases_[p] = Phase();
+                phases_[p].name = name;
+            }
+            frame_start_ = GetTotals();
+            last_frame_ = AllocationCounts();
+            frame_count_ = 0;
+            Counters().violations.store(0);
+        }
+
+        // A copy of the phase table, safe to read while phases are being recorded.
+        int GetPhases(Phase (&phases)[kMaxPhases]) const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (int p = 0; p < phase_count_; p++) {
+                phases[p] = phases_[p];
+            }
+            return phase_count_;
+        }
+        AllocationCounts GetLastFrame() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return last_frame_;
+        }
+        uint64_t GetFrameCount() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return frame_count_;
+        }
+
+        void Report(FILE* out) const {
+            Phase phases[kMaxPhases];
+            int count = GetPhases(phases);
+            std::fprintf(out, "phase,calls,allocations,bytes,allocations_per_call,worst_frame_allocations\n");
+            for (int p = 0; p < count; p++) {
+                const Phase& phase = phases[p];
+                std::fprintf(out, "%s,%llu,%llu,%llu,%.2f,%llu\n", phase.name, (unsigned long long)phase.calls,
+                             (unsigned long long)phase.total.allocations, (unsigned long long)phase.total.bytes,
+                             phase.calls > 0 ? double(phase.total.allocations) / double(phase.calls) : 0.0,
+                             (unsigned long long)phase.worst_frame.allocations);
+            }
+        }
+
+    private:
+        struct AtomicCounters {
+            std::atomic<uint64_t> allocations;
+            std::atomic<uint64_t> bytes;
+            std::atomic<uint64_t> violations;
+            std::atomic<int> forbidding;
+        };
+
+        // Constant-initialized, so the hook may run before any static constructor.
+        static AtomicCounters& Counters() {
+            static AtomicCounters counters = { { 0 }, { 0 }, { 0 }, { 0 } };
+            return counters;
+        }
+
+        static void Add(AllocationCounts& sum, const AllocationCounts& delta) {
+            sum.allocations += delta.allocations;
+            sum.bytes += delta.bytes;
+        }
+
+        Phase* FindPhase(const char* name) {
+            for (int p = 0; p < phase_count_; p++) {
+                if (phases_[p].name == name || std::strcmp(phases_[p].name, name) == 0) {
+                    return &phases_[p];
+                }
+            }
+            if (phase_count_ == kMaxPhases) {
+                return nullptr;
+            }
+            phases_[phase_count_].name = name; // names are string literals
+            return &phases_[phase_count_++];
+        }
+
+        mutable std::mutex mutex_;
+        Phase phases_[kMaxPhases]; // fixed, so recording never allocates
+        int phase_count_ = 0;
+        AllocationCounts frame_start_;
+        AllocationCounts last_frame_;
+        uint64_t frame_count_ = 0;
+    };
+
+    // Adds the allocations made during its lifetime to a phase.
+    class AllocationScope {
+    public:
+        explicit AllocationScope(const char* name, bool forbid = false)
+            : name_(name), forbid_(forbid), start_(AllocationTracker::GetInstance().GetTotals()) {
+            if (forbid_) {
+                AllocationTracker::GetInstance().EnterForbidding();
+            }
+        }
+        ~AllocationScope() {
+            AllocationTracker& tracker = AllocationTracker::GetInstance();
+            if (forbid_) {
+                tracker.ExitForbidding();
+            }
+            AllocationCounts end = tracker.GetTotals();
+            AllocationCounts delta;
+            delta.allocations = end.allocations - start_.allocations;
+            delta.bytes = end.bytes - start_.bytes;
+            tracker.RecordPhase(name_, delta);
+        }
+
+        AllocationScope(const AllocationScope&) = delete;
+        AllocationScope& operator=(const AllocationScope&) = delete;
+
+    private:
+        const char* name_;
+        bool forbid_;
+        AllocationCounts start_;
+    };
+}  // namespace GLOO
+
+#define GLOO_ALLOCATION_CONCAT_(a, b) a##b
+#define GLOO_ALLOCATION_CONCAT(a, b) GLOO_ALLOCATION_CONCAT_(a, b)
+
+#ifdef GLOO_TRACK_ALLOCATIONS
+#define GLOO_ALLOCATION_PHASE(name) \
+    ::GLOO::AllocationScope GLOO_ALLOCATION_CONCAT(allocation_scope_, __LINE__)(name)
+#define GLOO_FORBID_ALLOCATIONS(name) \
+    ::GLOO::AllocationScope GLOO_ALLOCATION_CONCAT(allocation_scope_, __LINE__)(name, true)
+#else
+#define GLOO_ALLOCATION_PHASE(name) static_cast<void>(0)
+#define GLOO_FORBID_ALLOCATIONS(name) static_cast<void>(0)
+#endif
+
+// The counting operator new/delete, compiled into exactly one translation unit.
+// They are kept out of line: inlined into the standard containers, GCC would
+// see malloc's memory handed to a `new` expression and released with free
+// (-Wmismatched-new-delete), although every path here pairs them correctly.
+#if defined(GLOO_TRACK_ALLOCATIONS) && defined(GLOO_ALLOCATION_TRACKER_IMPLEMENTATION)
+#if defined(__GNUC__)
+#define GLOO_ALLOCATION_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define GLOO_ALLOCATION_NOINLINE __declspec(noinline)
+#include <malloc.h> // _aligned_malloc
+#else
+#define GLOO_ALLOCATION_NOINLINE
+#endif
+GLOO_ALLOCATION_NOINLINE void* operator new(size_t size) {
+    ::GLOO::AllocationTracker::CountAllocation(size);
+    if (void* p = std::malloc(size > 0 ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+GLOO_ALLOCATION_NOINLINE void* operator new[](size_t size) {
+    return operator new(size);
+}
+GLOO_ALLOCATION_NOINLINE void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    ::GLOO::AllocationTracker::CountAllocation(size);
+    return std::malloc(size > 0 ? size : 1);
+}
+GLOO_ALLOCATION_NOINLINE void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+GLOO_ALLOCATION_NOINLINE void operator delete(void* p) noexcept {
+    std::free(p);
+}
+GLOO_ALLOCATION_NOINLINE void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+GLOO_ALLOCATION_NOINLINE void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+GLOO_ALLOCATION_NOINLINE void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+GLOO_ALLOCATION_NOINLINE void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+GLOO_ALLOCATION_NOINLINE void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+#if defined(__cpp_aligned_new)
+// Over-aligned types (alignas above the default new alignment) come through
+// these; they are counted like the rest.
+GLOO_ALLOCATION_NOINLINE void* operator new(size_t size, std::align_val_t alignment) {
+    ::GLOO::AllocationTracker::CountAllocation(size);
+    size_t align = std::max(size_t(alignment), sizeof(void*));
+#if defined(_MSC_VER)
+    if (void* p = _aligned_malloc(size > 0 ? size : 1, align)) {
+        return p;
+    }
+#else
+    void* p = nullptr;
+    if (posix_memalign(&p, align, size > 0 ? size : 1) == 0) {
+        return p;
+    }
+#endif
+    throw std::bad_alloc();
+}
+GLOO_ALLOCATION_NOINLINE void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+GLOO_ALLOCATION_NOINLINE void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size, alignment);
+    }
+    catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+GLOO_ALLOCATION_NOINLINE void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept {
+    return operator new(size, alignment, tag);
+}
+GLOO_ALLOCATION_NOINLINE void operator delete(void* p, std::align_val_t) noexcept {
+#if defined(_MSC_VER)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+GLOO_ALLOCATION_NOINLINE void operator delete[](void* p, std::align_val_t alignment) noexcept {
+    operator delete(p, alignment);
+}
+GLOO_ALLOCATION_NOINLINE void operator delete(void* p, size_t, std::align_val_t alignment) noexcept {
+    operator delete(p, alignment);
+}
+GLOO_ALLOCATION_NOINLINE void operator delete[](void* p, size_t, std::align_val_t alignment) noexcept {
+    operator delete(p, alignment);
+}
+GLOO_ALLOCATION_NOINLINE void operator delete(void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    operator delete(p, alignment);
+}
+GLOO_ALLOCATION_NOINLINE void operator delete[](void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    operator delete(p, alignment);
+}
+#endif
+#undef GLOO_ALLOCATION_NOINLINE
+#endif
+
+#endif
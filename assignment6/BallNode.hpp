@@ -1,257 +1,126 @@
 #ifndef BALL_NODE_H_
 #define BALL_NODE_H_
 
-#include "PendulumSystem.hpp"
-#include "IntegratorFactory.hpp"
+#include "AllocationTracker.hpp"
+#include "Diagnostics.hpp"
+#include "MeshExporter.hpp"
+#include "MultiResolutionBall.hpp"
+#include "ParticleInstancesNode.hpp"
+#include "StateHistory.hpp"
 #include "gloo/SceneNode.hpp"
 #include "gloo/components/MaterialComponent.hpp"
 #include "gloo/components/RenderingComponent.hpp"
 #include "gloo/components/ShadingComponent.hpp"
-#include "gloo/debug/PrimitiveFactory.hpp"
 #include "gloo/shaders/PhongShader.hpp"
 #include "gloo/shaders/SimpleShader.hpp"
 #include "gloo/InputManager.hpp"
-#include "GroundNode.hpp"
+#include "gloo/MeshLoader.hpp"
+#include <chrono>
 #include <cstdlib>
 #include <glm/gtx/string_cast.hpp>
 
 
 namespace GLOO {
+    // What BallNode draws: the shaded surface and the debug views of its particles and springs.
+    enum class BallView { Surface, Vertices, Radii, Chords, Mesh };
+    const int kBallViewCount = 5;
+    const char* const kBallViewNames[kBallViewCount] = { "Surface", "Vertices", "Radial springs", "Chordal springs",
+                                                         "Surface springs" };
+
     class BallNode : public SceneNode {
     public:
-        BallNode(IntegratorType integrator_type, float integration_step) {
-            // UI
-            drop_ball_ = false;
-
-            integrator_ = IntegratorFactory::CreateIntegrator<PendulumSystem, ParticleState>(integrator_type);
-            step_size_ = integration_step;
-
-            // initialize icosphere
-            InitIcosahedron();
-            SubdivideToIcosphere();
-            state_ = { positions_, velocities_ };
-
-            // render vertices
-            if (display_vertices_) {
-                for (size_t i = 0; i < positions_.size(); i++) {
-                    auto sphere_node = make_unique<SceneNode>();
-                    sphere_node->CreateComponent<MaterialComponent>(red_material_);
-                    sphere_node->CreateComponent<ShadingComponent>(shader_);
-                    sphere_node->CreateComponent<RenderingComponent>(sphere_mesh_);
-                    sphere_node_ptrs_.push_back(sphere_node.get());
-                    AddChild(std::move(sphere_node));
-                }
-            }
-
-            // add radial springs
-            for (size_t i = 1; i < positions_.size(); i++) {
-                system_.AddSpring(0, i, radial_l_, radial_k_);
-                if (display_radii_) {
-                    auto line_node = make_unique<SceneNode>();
-                    line_node->CreateComponent<MaterialComponent>(green_material_);
-                    line_node->CreateComponent<ShadingComponent>(line_shader_);
-
-                    auto positions = make_unique<PositionArray>();
-                    auto indices = make_unique<IndexArray>();
-                    auto line = std::make_shared<VertexObject>();
-                    positions->push_back(positions_[0]); // center node
-                    positions->push_back(positions_[i]);
-                    indices->push_back(0);
-                    indices->push_back(1);
-                    line->UpdatePositions(std::move(positions));
-                    line->UpdateIndices(std::move(indices));
-
-                    auto& rc_curve = line_node->CreateComponent<RenderingComponent>(line);
-                    rc_curve.SetDrawMode(DrawMode::Lines);
-                    radial_line_ptrs_.push_back(line);
-                    AddChild(std::move(line_node));
-                }
-            }
-
-            // add chordal springs
-            for (size_t i = 1; i < positions_.size(); i++) {
-                for (size_t j = 1; j < i; j++) {
-                    system_.AddSpring(i, j, glm::length(positions_[i] - positions_[j]), chordal_k_);
-                    if (display_chords_) {
-                        auto line_node = make_unique<SceneNode>();
-                        line_node->CreateComponent<MaterialComponent>(green_material_);
-                        line_node->CreateComponent<ShadingComponent>(line_shader_);
-
-                        auto positions = make_unique<PositionArray>();
-                        auto indices = make_unique<IndexArray>();
-                        auto line = std::make_shared<VertexObject>();
-                        positions->push_back(positions_[i]); // center node
-                        positions->push_back(positions_[j]);
-                        indices->push_back(0);
-                        indices->push_back(1);
-                        line->UpdatePositions(std::move(positions));
-                        line->UpdateIndices(std::move(indices));
-
-                        auto& rc_curve = line_node->CreateComponent<RenderingComponent>(line);
-                        rc_curve.SetDrawMode(DrawMode::Lines);
-                        chordal_line_ptrs_.push_back(line);
-                        AddChild(std::move(line_node));
-                    }
-                }
-            }
-
-            // add surface springs
-            for (size_t i = 0; i < triangles_.size(); i++) {
-                int i0 = triangles_[i][0];
-                int i1 = triangles_[i][1];
-                int i2 = triangles_[i][2];
-                glm::vec3 v0 = positions_[i0];
-                glm::vec3 v1 = positions_[i1];
-                glm::vec3 v2 = positions_[i2];
-                system_.AddSpring(i0, i1, glm::length(v1 - v0), surface_k_);
-                system_.AddSpring(i1, i2, glm::length(v2 - v1), surface_k_);
-                system_.AddSpring(i2, i0, glm::length(v0 - v2), surface_k_);
-
-                if (display_mesh_) {
-                    auto line_node = make_unique<SceneNode>();
-                    line_node->CreateComponent<MaterialComponent>(green_material_);
-                    line_node->CreateComponent<ShadingComponent>(line_shader_);
-
-                    auto positions = make_unique<PositionArray>();
-                    auto indices = make_unique<IndexArray>();
-                    auto line = std::make_shared<VertexObject>();
-                    positions->push_back(v0);
-                    positions->push_back(v1);
-                    positions->push_back(v2);
-                    indices->push_back(0);
-                    indices->push_back(1);
-                    indices->push_back(1);
-                    indices->push_back(2);
-                    indices->push_back(2);
-                    indices->push_back(0);
-                    line->UpdatePositions(std::move(positions));
-                    line->UpdateIndices(std::move(indices));
-
-                    auto& rc_curve = line_node->CreateComponent<RenderingComponent>(line);
-                    rc_curve.SetDrawMode(DrawMode::Lines);
-                    surface_line_ptrs_.push_back(line);
-                    AddChild(std::move(line_node));
-                }
-            }
-
-            // render surface
-            ComputeNormals();
-            if (display_surface_) {
-                auto surface_node = make_unique<SceneNode>();
-                surface_node->CreateComponent<ShadingComponent>(shader_);
-                surface_node->CreateComponent<MaterialComponent>(white_material_);
-                surface_node->CreateComponent<RenderingComponent>(normal_mesh_);
-                AddChild(std::move(surface_node));
-            }
+        BallNode(IntegratorType integrator_type, float integration_step, const std::string& mesh = "")
+            : BallNode(MakeParams(integrator_type, integration_step, mesh)) {
+        }
 
-            // make other objects (for collision purposes)
-            auto ground_node = make_unique<GroundNode>();
-            ground_ptr_ = ground_node.get();
-        };
+        explicit BallNode(const BallParams& params) : simulation_(params, start_center_, LoadMesh(params.mesh)) {
+            // only the views switched on are built; the debug views follow when switched on from the GUI
+            UpdateDisplay();
+        }
 
         void Reset() {
-            // reset state by clearing elements
-            positions_.clear();
-            velocities_.clear();
-            triangles_.clear();
-
-            InitIcosahedron();
-            SubdivideToIcosphere();
-            state_ = { positions_, velocities_ };
+            // rebuild the start state around the current start center
+            simulation_.Reset(start_center_);
+            history_.Clear();
+            scrubbing_ = false;
+            export_triangles_.reset();
+            UpdateDisplay();
         }
 
 
         void Update(double delta_time) {
-            static bool prev_released_d = true;
+            if (scrubbing_) {
+                return; // frozen on a history frame until ResumeFromHistory
+            }
+            GLOO_ALLOCATION_PHASE("BallNode::Update");
+
             if (InputManager::GetInstance().IsKeyPressed('D')) {
-                if (prev_released_d) {
-                    drop_ball_ = true;
+                if (prev_released_d_) {
+                    simulation_.Drop();
                 }
-                prev_released_d = false;
+                prev_released_d_ = false;
             }
             else {
-                prev_released_d = true;
+                prev_released_d_ = true;
             }
 
-            double start_time = 0.0;
-            while (start_time < delta_time) {
-                state_ = integrator_->Integrate(system_, state_, start_time, fmin(step_size_, delta_time)); // step sizes cannot be greater than time
-
-                if (!drop_ball_) {
-                    state_.velocities = velocities_;
+            double step_ms = 0.0;
+            if (!simulation_.IsAsleep()) { // settled and held balls cost nothing
+                simulation_.SetDiagnostics(record_diagnostics_ ? &diagnostics_ : nullptr); // sampled every step
+                auto step_start = std::chrono::steady_clock::now();
+                simulation_.Step(delta_time);
+                step_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - step_start).count();
+                if (record_history_) {
+                    GLOO_ALLOCATION_PHASE("StateHistory::Record");
+                    history_.Record(simulation_.GetState(), { simulation_.GetStepStats().simulated_time, simulation_.GetLevel(),
+                                                              simulation_.IsDropped(), simulation_.IsAsleep() });
                 }
-
-                // update vertices
-                for (size_t i = 0; i < state_.positions.size(); i++) {
-                    // float lower = 0.0;
-                    float eps = 0.01;
-                    if (ground_ptr_->InBounds(state_.positions[i], eps)) {
-                        state_.velocities[i] = glm::vec3(0.f, 1.f, 0.f);
-                    }
-                    if (display_vertices_) {
-                        sphere_node_ptrs_[i]->GetTransform().SetPosition(state_.positions[i]);
-                    }
+                if (exporter_ != nullptr) {
+                    GLOO_ALLOCATION_PHASE("BallNode::ExportFrame");
+                    ExportFrame();
                 }
+                UpdateDisplay();
+            }
 
-                // update radial springs
-                if (display_radii_) {
-                    for (size_t i = 1; i < state_.positions.size(); i++) {
-                        auto line = radial_line_ptrs_[i - 1];
-                        auto line_positions = make_unique<PositionArray>();
-                        auto line_indices = make_unique<IndexArray>();
-                        line_positions->push_back(state_.positions[0]);
-                        line_positions->push_back(state_.positions[i]);
-                        line->UpdatePositions(std::move(line_positions));
-                    }
-                }
-
-                // update chordal springs
-                if (display_chords_) {
-                    for (size_t i = 1; i < state_.positions.size(); i++) {
-                        for (size_t j = i; j < i; j++) {
-                            auto line = chordal_line_ptrs_[i - 1];
-                            auto line_positions = make_unique<PositionArray>();
-                            auto line_indices = make_unique<IndexArray>();
-                            line_positions->push_back(state_.positions[0]);
-                            line_positions->push_back(state_.positions[i]);
-                            line->UpdatePositions(std::move(line_positions));
-                        }
-                    }
-                }
-
-
-                // update surface springs
-                if (display_mesh_) {
-                    for (size_t i = 0; i < triangles_.size(); i++) {
-                        auto line = surface_line_ptrs_[i];
-                        auto line_positions = make_unique<PositionArray>();
-                        auto line_indices = make_unique<IndexArray>();
-                        line_positions->push_back(state_.positions[triangles_[i][0]]);
-                        line_positions->push_back(state_.positions[triangles_[i][1]]);
-                        line_positions->push_back(state_.positions[triangles_[i][2]]);
-                        line->UpdatePositions(std::move(line_positions));
-                    }
-                }
-
-                // update normals
-                ComputeNormals();
-
-                start_time += step_size_;
+            // level of detail from camera distance or simulation cost
+            int level = simulation_.GetLevel();
+            double distance = 0.0;
+            if (linked_camera_ != nullptr) {
+                distance = glm::length(linked_camera_->GetTransform().GetWorldPosition() - simulation_.GetState().positions[0]);
+            }
+            simulation_.UpdateLevel(lod_settings_, delta_time, distance, step_ms);
+            if (simulation_.GetLevel() != level) {
+                UpdateDisplay();
             }
 
-            static bool prev_released = true;
             if (InputManager::GetInstance().IsKeyPressed('R')) {
-                if (prev_released) {
-                    drop_ball_ = false;
-                    state_ = { positions_, velocities_ };
+                if (prev_released_r_) {
+                    simulation_.Restart();
+                    history_.Clear();
+                    UpdateDisplay();
                 }
-                prev_released = false;
+                prev_released_r_ = false;
             }
             else {
-                prev_released = true;
+                prev_released_r_ = true;
             }
         }
 
+        void Drop() {
+            simulation_.Drop();
+        }
+        void Wake() {
+            simulation_.Wake();
+        }
+        void SetGround(const GroundCollider& ground) {
+            simulation_.SetGround(ground);
+        }
+        bool IsAsleep() const {
+            return simulation_.IsAsleep();
+        }
+        MultiResolutionBall& GetSimulation() {
+            return simulation_;
+        }
 
         // GUI Functions
         void LinkControl(float*& height, float*& x, float*& z) {
@@ -259,150 +128,255 @@ namespace GLOO {
             linked_x_ = x;
             linked_z_ = z;
         }
+        void LinkCamera(SceneNode* camera) {
+            linked_camera_ = camera;
+        }
+        LodSettings& GetLodSettings() {
+            return lod_settings_;
+        }
+        int GetLevel() const {
+            return simulation_.GetLevel();
+        }
+        const BallSimulation::StepStats& GetStepStats() const {
+            return simulation_.GetStepStats();
+        }
+        // Rewind: shows retained frame k (0 is the oldest) and pauses the simulation there.
+        void ScrubTo(size_t k) {
+            ParticleState state;
+            StateHistory<float>::FrameInfo info;
+            if (!history_.Restore(k, state, info)) {
+                return;
+            }
+            scrubbing_ = true;
+            scrub_frame_ = k;
+            simulation_.SetLevel(info.level);
+            simulation_.Active().SetState(state, info.dropped, true);
+            UpdateDisplay();
+        }
+        // Continues simulating from the scrubbed frame; later frames are discarded.
+        void ResumeFromHistory() {
+            ParticleState state;
+            StateHistory<float>::FrameInfo info;
+            if (!scrubbing_ || !history_.Restore(scrub_frame_, state, info)) {
+                return;
+            }
+            history_.Truncate(scrub_frame_);
+            BallSimulation& active = simulation_.Active();
+            active.SetState(state, info.dropped, info.asleep);
+            BallSimulation::StepStats stats = active.GetStepStats();
+            stats.simulated_time = info.time;
+            active.SetStepStats(stats);
+            scrubbing_ = false;
+        }
+        bool IsScrubbing() const {
+            return scrubbing_;
+        }
+        size_t GetScrubFrame() const {
+            return scrub_frame_;
+        }
+        const StateHistory<float>& GetHistory() const {
+            return history_;
+        }
+        bool& RecordHistory() {
+            return record_history_;
+        }
+
+        // Exports the surface after every simulated frame as <export_name>_<frame>; nullptr stops.
+        // The exporter is shared between balls and must outlive the export.
+        void SetExporter(MeshExporter* exporter, const std::string& export_name) {
+            exporter_ = exporter;
+            export_name_ = export_name;
+            export_frame_ = 0;
+        }
+
+        // Shows or hides one view of the ball. A view's scene node and buffers are built
+        // the first time it is shown; switched off, it is hidden and no longer updated.
+        void SetViewVisible(BallView view, bool visible) {
+            view_visible_[int(view)] = visible;
+            if (SceneNode* node = GetViewNode(view)) {
+                node->SetActive(visible);
+            }
+            if (visible) {
+                UpdateDisplay();
+            }
+        }
+        bool IsViewVisible(BallView view) const {
+            return view_visible_[int(view)];
+        }
+
+        DiagnosticsRecorder& GetDiagnostics() {
+            return diagnostics_;
+        }
+        bool& RecordDiagnostics() {
+            return record_diagnostics_;
+        }
+        int GetMaxSubsteps() const {
+            return simulation_.GetParams().max_substeps;
+        }
+        void SetMaxSubsteps(int max_substeps) {
+            simulation_.SetMaxSubsteps(max_substeps);
+        }
         void OnParamsChanged() {
             start_center_ = glm::vec3(*linked_x_, *linked_height_, *linked_z_);
             Reset();
         }
 
 
-    private:
-        void InitIcosahedron() {
-            // center
-            AddVertex(icosa_vertices_[0] * scale_ + start_center_, center_mass_, center_fixed_);
-
-            // 12 vertices
-            for (int i = 1; i <= 12; i++) {
-                AddVertex(icosa_vertices_[i] * scale_ + start_center_, vertex_mass_, vertex_fixed_);
+        // Caps the substeps of an unlimited ball so slow frames drop time instead of stalling the app.
+        static BallParams InteractiveParams(BallParams params) {
+            if (params.max_substeps == 0) {
+                params.max_substeps = std::max(1, int(kMaxFrameTime / params.step_size));
             }
+            return params;
+        }
 
-            // 20 faces
-            for (glm::vec3 face : icosa_faces_) {
-                triangles_.push_back(face + glm::vec3(1, 1, 1)); // adjust indices by one since center is at index 0
+    private:
+        static const size_t kLineGrain = 1 << 15;
+        static constexpr double kMaxFrameTime = 0.1; // s of simulation per frame before time is dropped
+
+        static BallParams MakeParams(IntegratorType integrator_type, float integration_step, const std::string& mesh) {
+            BallParams params;
+            params.integrator = integrator_type;
+            params.step_size = integration_step;
+            params.mesh = mesh;
+            return InteractiveParams(params);
+        }
+        static SurfaceMeshT<float> LoadMesh(const std::string& filename) {
+            // empty name: the built-in icosphere
+            if (filename.empty()) {
+                return SurfaceMeshT<float>();
             }
+            MeshData mesh_data = MeshLoader::Import(filename);
+            const PositionArray& positions = mesh_data.vertex_obj->GetPositions();
+            const IndexArray& indices = mesh_data.vertex_obj->GetIndices();
+            return MeshBodyBuilder<float>::Weld(positions, std::vector<uint32_t>(indices.begin(), indices.end()));
         }
-        void SubdivideToIcosphere() {
-            // http://www.songho.ca/opengl/gl_sphere.html
-            //         v0       
-            //        / \       
-            //    v3 *---* v5
-            //      / \ / \     
-            //    v1---*---v2   
-            //         v4     
-            for (int n = 0; n < subdivisions_ - surface_layers_ + 1; n++) { // final icosphere only includes last layer of this loop
-                std::vector<glm::vec3> temp_triangles;
-                for (glm::vec3 triangle : triangles_) {
-                    // original vertices
-                    int i0 = triangle[0];
-                    int i1 = triangle[1];
-                    int i2 = triangle[2];
-
-                    // new vertices
-                    int i3 = AddMidpoint(i0, i1, vertex_mass_, vertex_fixed_);
-                    int i4 = AddMidpoint(i1, i2, vertex_mass_, vertex_fixed_);
-                    int i5 = AddMidpoint(i2, i0, vertex_mass_, vertex_fixed_);
-
-                    // new faces
-                    temp_triangles.push_back(glm::vec3(i0, i3, i5));
-                    temp_triangles.push_back(glm::vec3(i3, i1, i4));
-                    temp_triangles.push_back(glm::vec3(i5, i4, i2));
-                    temp_triangles.push_back(glm::vec3(i3, i4, i5));
+        void ExportFrame() {
+            // the triangles are only copied when the level (and with it the surface) changes
+            if (export_triangles_ == nullptr || export_level_ != simulation_.GetLevel()) {
+                export_triangles_ = std::make_shared<const std::vector<glm::vec3>>(simulation_.GetTriangles());
+                export_level_ = simulation_.GetLevel();
+            }
+            exporter_->Submit(export_name_, export_frame_++, simulation_.GetState().positions, export_triangles_);
+        }
+        void UpdateDisplay() {
+            GLOO_ALLOCATION_PHASE("BallNode::UpdateDisplay");
+            const ParticleState& state = simulation_.GetState();
+
+            // update vertices
+            if (IsViewVisible(BallView::Vertices)) { // one buffer for all particles, at any level
+                if (particle_instances_ptr_ == nullptr) {
+                    auto instances_node = make_unique<ParticleInstancesNode>(0.03f, red_material_, shader_);
+                    particle_instances_ptr_ = instances_node.get();
+                    AddChild(std::move(instances_node));
+                }
+                particle_instances_ptr_->SetInstances(state.positions);
+            }
+
+            // update radial, chordal and surface springs
+            for (BallView view : { BallView::Radii, BallView::Chords, BallView::Mesh }) {
+                if (IsViewVisible(view)) {
+                    UpdateLines(view);
                 }
-                midpt_cache_.clear();
-                triangles_ = temp_triangles;
             }
-            std::vector<glm::vec3> new_triangles = triangles_; // if surface_layers == subdivisions_ + 1, then this is original triangles_ (otherwise, comes from previous loop)
-            for (int n = subdivisions_ - surface_layers_ + 1; n < subdivisions_; n++) {
-                for (glm::vec3 triangle : triangles_) {
-                    // original vertices
-                    int i0 = triangle[0];
-                    int i1 = triangle[1];
-                    int i2 = triangle[2];
-
-                    // new vertices
-                    int i3 = AddMidpoint(i0, i1, vertex_mass_, vertex_fixed_);
-                    int i4 = AddMidpoint(i1, i2, vertex_mass_, vertex_fixed_);
-                    int i5 = AddMidpoint(i2, i0, vertex_mass_, vertex_fixed_);
-
-                    // new faces
-                    new_triangles.push_back(glm::vec3(i0, i3, i5));
-                    new_triangles.push_back(glm::vec3(i3, i1, i4));
-                    new_triangles.push_back(glm::vec3(i5, i4, i2));
-                    new_triangles.push_back(glm::vec3(i3, i4, i5));
+
+            // update surface
+            if (IsViewVisible(BallView::Surface)) {
+                if (surface_node_ptr_ == nullptr) {
+                    auto surface_node = make_unique<SceneNode>();
+                    surface_node->CreateComponent<ShadingComponent>(shader_);
+                    surface_node->CreateComponent<MaterialComponent>(white_material_);
+                    surface_node->CreateComponent<RenderingComponent>(normal_mesh_);
+                    surface_node_ptr_ = surface_node.get();
+                    AddChild(std::move(surface_node));
                 }
-                midpt_cache_.clear();
-                triangles_ = new_triangles;
+                ComputeNormals();
+            }
+        }
+        void UpdateLines(BallView view) {
+            // all springs of a kind are one line list over the particle positions
+            LineView& lines = line_views_[int(view) - int(BallView::Radii)];
+            if (lines.node == nullptr) {
+                auto line_node = make_unique<SceneNode>();
+                line_node->CreateComponent<MaterialComponent>(green_material_);
+                line_node->CreateComponent<ShadingComponent>(line_shader_);
+                auto& rc_lines = line_node->CreateComponent<RenderingComponent>(lines.mesh);
+                rc_lines.SetDrawMode(DrawMode::Lines);
+                lines.node = line_node.get();
+                AddChild(std::move(line_node));
             }
+            if (lines.level != simulation_.GetLevel()) { // the springs only change with the level
+                lines.mesh->UpdateIndices(LineIndices(view));
+                lines.level = simulation_.GetLevel();
+            }
+            lines.mesh->UpdatePositions(make_unique<PositionArray>(simulation_.GetState().positions));
         }
-        void AddVertex(glm::vec3 position, float mass, bool fixed) {
-            positions_.push_back(position);
-            velocities_.push_back(start_velocity_);
-            system_.AddMass(mass, fixed);
-        }
-        int AddMidpoint(int i0, int i1, float mass, bool fixed) {
-            int i2 = GetMidpointIndex(i0, i1);
-            if (i2 == positions_.size()) {
-                glm::vec3 v0 = positions_[i0] - positions_[0];
-                glm::vec3 v1 = positions_[i1] - positions_[0];
-                glm::vec3 v2 = glm::normalize(v0 + v1) * (glm::length(v0) + glm::length(v1)) / 2.f;
-                AddVertex(v2 + positions_[0], mass, fixed);
+        std::unique_ptr<IndexArray> LineIndices(BallView view) const {
+            auto indices = make_unique<IndexArray>();
+            if (view == BallView::Radii) {
+                for (size_t i = 1; i < simulation_.GetState().positions.size(); i++) {
+                    indices->push_back(0); // center node
+                    indices->push_back(unsigned(i));
+                }
             }
-            return i2;
-        }
-        int GetMidpointIndex(int i0, int i1) { // indices of endpts
-            int key = (i0 * i1 << 12) + (i0 + i1); // "hash" of unordered pair (i0, i1)
-            auto search = midpt_cache_.find(key);
-            if (search == midpt_cache_.end()) { // midpoint is a new vertex
-                midpt_cache_.insert({ key, positions_.size() });
-                return positions_.size();
+            else if (view == BallView::Chords) {
+                for (const SpringGroupT<float>& group : simulation_.GetSystem().GetSpringGroups()) {
+                    if (group.kind != SpringKind::Chordal) {
+                        continue;
+                    }
+                    size_t offset = indices->size();
+                    indices->resize(offset + 2 * group.size());
+                    IndexArray& out = *indices;
+                    ThreadPool::GetInstance().ParallelFor(group.size(), kLineGrain, [&](size_t begin, size_t end) {
+                        for (size_t s = begin; s < end; s++) {
+                            out[offset + 2 * s] = group.first[s];
+                            out[offset + 2 * s + 1] = group.second[s];
+                        }
+                    });
+                }
             }
             else {
-                return search->second; // midpoint is already a vertex
+                for (const glm::vec3& triangle : simulation_.GetTriangles()) {
+                    for (int c = 0; c < 3; c++) {
+                        indices->push_back(unsigned(triangle[c]));
+                        indices->push_back(unsigned(triangle[(c + 1) % 3]));
+                    }
+                }
+            }
+            return indices;
+        }
+        SceneNode* GetViewNode(BallView view) const {
+            switch (view) {
+                case BallView::Surface:
+                    return surface_node_ptr_;
+                case BallView::Vertices:
+                    return particle_instances_ptr_;
+                default:
+                    return line_views_[int(view) - int(BallView::Radii)].node;
             }
         }
         void ComputeNormals() { // add surface normals to sphere (simultaneously calculate areas and volume)
-            auto normal_positions = make_unique<PositionArray>();
-            auto normal_indicies = make_unique<IndexArray>();
+            GLOO_ALLOCATION_PHASE("BallNode::ComputeNormals");
+            auto normal_positions = make_unique<PositionArray>(simulation_.GetState().positions);
             auto normals = make_unique<NormalArray>();
-            std::vector<glm::vec3> normal_sums;
-            float volume = 0.f;
-            glm::vec3 p = state_.positions[0]; // anchor point to calculate volume of each tetrahedron
 
-            for (int i = 0; i < state_.positions.size(); i++) {
-                normal_positions->push_back(state_.positions[i]); // load in all positions
-                normal_sums.push_back(glm::vec3(0.f)); // initialize normals array
-            }
-            for (glm::vec3 triangle : triangles_) {
-                // load in all triangle indicies
-                normal_indicies->push_back(triangle[0]);
-                normal_indicies->push_back(triangle[1]);
-                normal_indicies->push_back(triangle[2]);
-
-                // add the normals of incident faces to each vertex normal
-                int idx1 = triangle[0];
-                int idx2 = triangle[1];
-                int idx3 = triangle[2];
-                glm::vec3 v1 = state_.positions[idx2] - state_.positions[idx1];
-                glm::vec3 v2 = state_.positions[idx3] - state_.positions[idx1];
-                glm::vec3 normal = glm::cross(v1, v2);
-                normal_sums[idx1] += normal;
-                normal_sums[idx2] += normal;
-                normal_sums[idx3] += normal;
-
-                // calculate signed volume of tetrahedron with vertex "p" and opposite face "triangle"
-                glm::vec3 w1 = state_.positions[idx1] - p;
-                glm::vec3 w2 = state_.positions[idx2] - p;
-                glm::vec3 w3 = state_.positions[idx3] - p;
-                volume += glm::dot(w1, glm::cross(w2, w3)) / 6.f; // triple product for signed volume
+            if (surface_level_ != simulation_.GetLevel()) { // the triangles only change with the level
+                auto normal_indicies = make_unique<IndexArray>();
+                for (glm::vec3 triangle : simulation_.GetTriangles()) {
+                    // load in all triangle indicies
+                    normal_indicies->push_back(triangle[0]);
+                    normal_indicies->push_back(triangle[1]);
+                    normal_indicies->push_back(triangle[2]);
+                }
+                normal_mesh_->UpdateIndices(std::move(normal_indicies));
+                surface_level_ = simulation_.GetLevel();
             }
-            for (int i = 0; i < normal_sums.size(); i++) {
-                normals->push_back(glm::normalize(normal_sums[i])); // normalize the sum of normals for vertex
+            for (const glm::vec3& normal_sum : simulation_.GetSystem().GetNormals()) { // kept current by the simulation
+                normals->push_back(glm::normalize(normal_sum)); // normalize the sum of normals for vertex
             }
 
             normal_mesh_->UpdatePositions(std::move(normal_positions));
-            normal_mesh_->UpdateIndices(std::move(normal_indicies));
             normal_mesh_->UpdateNormals(std::move(normals));
-            system_.SetNormals(normal_sums);
-            system_.SetVolume(fabs(volume));
         }
 
         bool OutOfBounds(glm::vec3 position, float lower, float eps) {
@@ -433,97 +407,45 @@ namespace GLOO {
             glm::vec3(0.2f, 0.2f, 0.2f), 20.0f);
         std::shared_ptr<SimpleShader> line_shader_ = std::make_shared<SimpleShader>();
         std::shared_ptr<PhongShader> shader_ = std::make_shared<PhongShader>();
-        std::shared_ptr<VertexObject> sphere_mesh_ = PrimitiveFactory::CreateSphere(0.03f, 25, 25);
         std::shared_ptr<VertexObject> normal_mesh_ = std::make_shared<VertexObject>();
 
-        // SCENENODE POINTERS
-        std::vector<SceneNode*> sphere_node_ptrs_;
-        std::vector<std::shared_ptr<VertexObject>> surface_line_ptrs_;
-        std::vector<std::shared_ptr<VertexObject>> chordal_line_ptrs_;
-        std::vector<std::shared_ptr<VertexObject>> radial_line_ptrs_;
-        //SceneNode* mesh_node_;
+        // SCENENODE POINTERS (each view is built on first use)
+        struct LineView {
+            SceneNode* node = nullptr;
+            std::shared_ptr<VertexObject> mesh = std::make_shared<VertexObject>();
+            int level = -1; // level whose springs the indices hold
+        };
+        ParticleInstancesNode* particle_instances_ptr_ = nullptr;
+        SceneNode* surface_node_ptr_ = nullptr;
+        LineView line_views_[3]; // radii, chords, mesh
+        int surface_level_ = -1; // level whose triangles normal_mesh_ holds
 
         // SIMULATION INFO
-        std::vector<glm::vec3> positions_;
-        std::vector<glm::vec3> velocities_;
-        std::vector<glm::vec3> triangles_;
-        ParticleState state_;
-        PendulumSystem system_;
-        std::unique_ptr<IntegratorBase<PendulumSystem, ParticleState>> integrator_;
-        float step_size_;
-
-        // DISPLAY TOGGLES 
-        bool display_vertices_ = false;
-        bool display_chords_ = true;
-        bool display_radii_ = false;
-        bool display_mesh_ = false;
-        bool display_surface_ = false;
-
-        // ICOSPHERE PARAMS
-        glm::vec3 start_center_ = glm::vec3(0.f, 1.f, 0.f);
-        glm::vec3 start_velocity_ = glm::vec3(0.f, 0.f, 0.f);
-        bool center_fixed_ = false;
-        bool vertex_fixed_ = false;
-        const float scale_ = 0.2;
-        const int subdivisions_ = 3;
-        const int surface_layers_ = 1; // must have 1 <= surface_layers_ <= subdivisions_ + 1
-        const float center_mass_ = 0.01f;
-        const float vertex_mass_ = 0.0001;
-        const float surface_k_ = 30.f;
-        const float chordal_k_ = 10.0f;
-        const float radial_k_ = 0.0f;
-        const float radial_l_ = 1.90211 * scale_; // circumradius
-        std::unordered_map<int, int> midpt_cache_;
-
-        // http://blog.andreaskahler.com/2009/06/creating-icosphere-mesh-in-code.html
-        // ICOSAHEDRON DATA (edge length 2) 
-        const float t_ = (1.f + sqrt(5.f)) / 2.f;
-        const std::vector<glm::vec3> icosa_vertices_{ // (x,y,z) coords for each vertex of nontransformed icosahedron
-            glm::vec3(0.f, 0.f, 0.f), // center
-            glm::vec3(-1.f, t_, 0.f), // 12 vertices
-            glm::vec3(1.f, t_, 0.f),
-            glm::vec3(-1.f, -t_, 0.f),
-            glm::vec3(1.f, -t_, 0.f),
-            glm::vec3(0.f, -1.f, t_),
-            glm::vec3(0.f, 1.f, t_),
-            glm::vec3(0.f, -1.f, -t_),
-            glm::vec3(0.f, 1.f, -t_),
-            glm::vec3(t_, 0.f, -1),
-            glm::vec3(t_, 0.f, 1.f),
-            glm::vec3(-t_, 0.f, -1),
-            glm::vec3(-t_, 0.f, 1.f),
-        };
-        const std::vector<glm::vec3> icosa_faces_{ // (i,j,k) vertex indices for each face of icosahedron
-            glm::vec3(0, 11, 5),                   // indexed by 0 (notice icosa_vertices_ are indexed by 1
-            glm::vec3(0, 5, 1),                    // since the center is at the 0th index)
-            glm::vec3(0, 1, 7),
-            glm::vec3(0, 7, 10),
-            glm::vec3(0, 10, 11),
-            glm::vec3(1, 5, 9),
-            glm::vec3(5, 11, 4),
-            glm::vec3(11, 10, 2),
-            glm::vec3(10, 7, 6),
-            glm::vec3(7, 1, 8),
-            glm::vec3(3, 9, 4),
-            glm::vec3(3, 4, 2),
-            glm::vec3(3, 2, 6),
-            glm::vec3(3, 6, 8),
-            glm::vec3(3, 8, 9),
-            glm::vec3(4, 9, 5),
-            glm::vec3(2, 4, 11),
-            glm::vec3(6, 2, 10),
-            glm::vec3(8, 6, 7),
-            glm::vec3(9, 8, 1),
-        };
+        glm::vec3 start_center_ = glm::vec3(0.f, 1.f, 0.f); // declared before simulation_, which starts here
+        MultiResolutionBall simulation_;
+        LodSettings lod_settings_;
+        DiagnosticsRecorder diagnostics_;
+        bool record_diagnostics_ = false; // sampled after every integration step
+        StateHistory<float> history_;
+        bool record_history_ = true;
+        bool scrubbing_ = false;
+        size_t scrub_frame_ = 0;
+        MeshExporter* exporter_ = nullptr;
+        std::string export_name_;
+        int export_frame_ = 0;
+        MeshExporter::Triangles export_triangles_; // shared by every queued frame of the current surface
+        int export_level_ = 0;
+
+        // DISPLAY TOGGLES (indexed by BallView)
+        bool view_visible_[kBallViewCount] = { true, false, false, false, false };
 
         // UI Controls
-        bool drop_ball_;
+        bool prev_released_d_ = true; // per ball, so every ball sees each key press
+        bool prev_released_r_ = true;
         float* linked_height_;
         float* linked_x_;
         float* linked_z_;
-
-        // other objects
-        GroundNode* ground_ptr_;
+        SceneNode* linked_camera_ = nullptr;
     };
 } // namespace GLOO
 
@@ -0,0 +1,118 @@
+#ifndef BALL_PARAMS_H_
+#define BALL_PARAMS_H_
+
+#include <stdexcept>
+#include <string>
+
+#include "IntegratorType.hpp"
+#include "ParticleOrdering.hpp"
+
+
+namespace GLOO {
+    // Runtime parameters of one soft-body ball. Defaults reproduce the original
+    // hard-coded BallNode/PendulumSystem constants.
+    struct BallParams {
+        // ICOSPHERE PARAMS
+        double scale = 0.2;
+        int subdivisions = 3;
+        int surface_layers = 1; // must have 1 <= surface_layers <= subdivisions + 1
+        double center_mass = 0.01;
+        double vertex_mass = 0.0001;
+        bool center_fixed = false;
+        bool vertex_fixed = false;
+        double surface_k = 30.0;
+        double chordal_k = 10.0;
+        double radial_k = 0.0;
+        ParticleOrdering ordering = ParticleOrdering::None; // optional renumbering for cache locality (see ParticleOrdering.hpp)
+
+        // MESH BODY PARAMS (used instead of the icosphere when `mesh` names an OBJ file)
+        std::string mesh;
+        double bending_k = 5.0;
+        double interior_k = 10.0; // center spokes and interior chords; 0 leaves the body hollow
+        int interior_chords = 2; // per surface vertex
+
+        // FORCE PARAMS
+        double b = 0.0001; // drag constant
+        double nRT = 2.0; // pressure constant
+
+        // SELF-COLLISION PARAMS
+        bool self_collision = false; // a hash build and query per step; on for bodies that fold onto themselves
+        double self_collision_thickness = 0.25; // fraction of the mean surface edge length
+
+        // INTEGRATION PARAMS
+        IntegratorType integrator = IntegratorType::RK4;
+        double step_size = 0.001;
+        int max_substeps = 0; // per Step call; time beyond it is dropped (0: unlimited)
+        bool deterministic = false; // bit-identical results for any thread count (see ExecutionMode)
+
+        // SLEEP PARAMS
+        double sleep_kinetic_energy = 1e-5; // J, of the center of mass's mean motion over the window
+        double sleep_speed = 0.02; // center-of-mass drift over the window / sleep_window, m/s
+        double sleep_window = 1.0; // s
+
+        double radial_l() const {
+            return 1.90211 * scale; // circumradius
+        }
+    };
+
+    inline IntegratorType ParseIntegratorType(const std::string& value) {
+        if (value == "e" || value == "euler") {
+            return IntegratorType::Euler;
+        } else if (value == "t" || value == "trapezoidal") {
+            return IntegratorType::Trapezoidal;
+        } else if (value == "r" || value == "rk4") {
+            return IntegratorType::RK4;
+        } else if (value == "x" || value == "xpbd") {
+            return IntegratorType::XPBD;
+        } else if (value == "m" || value == "multirate") {
+            return IntegratorType::MultiRate;
+        }
+        throw std::runtime_error("Unrecognized integrator type: " + value + ".");
+    }
+
+    inline ParticleOrdering ParseParticleOrdering(const std::string& value) {
+        if (value == "none") {
+            return ParticleOrdering::None;
+        } else if (value == "morton") {
+            return ParticleOrdering::Morton;
+        } else if (value == "rcm") {
+            return ParticleOrdering::ReverseCuthillMcKee;
+        }
+        throw std::runtime_error("Unrecognized particle ordering: " + value + ".");
+    }
+
+    // Sets a parameter from its name (the member name above) and textual value.
+    // Returns false if the name is not a ball parameter.
+    inline bool SetBallParam(BallParams& params, const std::string& name, const std::string& value) {
+        if (name == "scale") params.scale = std::stod(value);
+        else if (name == "subdivisions") params.subdivisions = std::stoi(value);
+        else if (name == "surface_layers") params.surface_layers = std::stoi(value);
+        else if (name == "center_mass") params.center_mass = std::stod(value);
+        else if (name == "vertex_mass") params.vertex_mass = std::stod(value);
+        else if (name == "center_fixed") params.center_fixed = std::stoi(value) != 0;
+        else if (name == "vertex_fixed") params.vertex_fixed = std::stoi(value) != 0;
+        else if (name == "surface_k") params.surface_k = std::stod(value);
+        else if (name == "chordal_k") params.chordal_k = std::stod(value);
+        else if (name == "radial_k") params.radial_k = std::stod(value);
+        else if (name == "mesh") params.mesh = value;
+        else if (name == "bending_k") params.bending_k = std::stod(value);
+        else if (name == "interior_k") params.interior_k = std::stod(value);
+        else if (name == "interior_chords") params.interior_chords = std::stoi(value);
+        else if (name == "ordering") params.ordering = ParseParticleOrdering(value);
+        else if (name == "b") params.b = std::stod(value);
+        else if (name == "nRT") params.nRT = std::stod(value);
+        else if (name == "self_collision") params.self_collision = std::stoi(value) != 0;
+        else if (name == "self_collision_thickness") params.self_collision_thickness = std::stod(value);
+        else if (name == "integrator") params.integrator = ParseIntegratorType(value);
+        else if (name == "step_size") params.step_size = std::stod(value);
+        else if (name == "max_substeps") params.max_substeps = std::stoi(value);
+        else if (name == "deterministic") params.deterministic = std::stoi(value) != 0;
+        else if (name == "sleep_kinetic_energy") params.sleep_kinetic_energy = std::stod(value);
+        else if (name == "sleep_speed") params.sleep_speed = std::stod(value);
+        else if (name == "sleep_window") params.sleep_window = std::stod(value);
+        else return false;
+        return true;
+    }
+}  // namespace GLOO
+
+#endif
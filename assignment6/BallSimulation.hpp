@@ -0,0 +1,358 @@
+#ifndef BALL_SIMULATION_H_
+#define BALL_SIMULATION_H_
+
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "AllocationTracker.hpp"
+#include "BallParams.hpp"
+#include "BodyContact.hpp"
+#include "Diagnostics.hpp"
+#include "GroundCollider.hpp"
+#include "IcosphereBuilder.hpp"
+#include "IntegratorFactory.hpp"
+#include "MeshBodyBuilder.hpp"
+#include "ParticleOrdering.hpp"
+#include "PendulumSystem.hpp"
+#include "SelfCollision.hpp"
+
+
+namespace GLOO {
+    // Scene-graph-free soft body (the icosphere ball, or any closed mesh):
+    // topology, pendulum system, integrator, ground response and rest detection.
+    // BallNode renders one of these; the headless tools run them directly.
+    template <class T>
+    class BallSimulationT {
+    public:
+        using Vec3 = glm::vec<3, T>;
+        using State = ParticleStateT<T>;
+        using System = PendulumSystemT<T>;
+
+        explicit BallSimulationT(const BallParams& params, Vec3 start_center = Vec3(T(0), T(1), T(0)))
+            : params_(params), start_center_(start_center) {
+            Init();
+        }
+
+        // Soft body from an arbitrary closed surface (see MeshBodyBuilder) instead of the icosphere.
+        BallSimulationT(const BallParams& params, Vec3 start_center, const SurfaceMeshT<T>& mesh)
+            : params_(params), start_center_(start_center), mesh_(mesh) {
+            MeshBodyBuilder<T>::Normalize(mesh_);
+            Init();
+        }
+
+        void Reset(Vec3 start_center) {
+            // rebuild the start state around a new start center
+            start_center_ = start_center;
+            BuildBody();
+            state_ = { positions_, velocities_ };
+            system_.UpdateSurface(state_.positions);
+            system_.SetRestVolume(system_.GetVolume());
+            if (dropped_) {
+                Wake(); // parameter changes restart a dropped ball
+            }
+            else {
+                Sleep();
+            }
+        }
+
+        void Restart() {
+            // back to the held start state
+            dropped_ = false;
+            state_ = { positions_, velocities_ };
+            system_.UpdateSurface(state_.positions);
+            Sleep();
+        }
+
+        void Drop() {
+            dropped_ = true;
+            Wake();
+        }
+
+        // Replaces the dynamic state, e.g. with one transferred from another level of detail,
+        // which also hands over the time it had not integrated yet.
+        void SetState(const State& state, bool dropped, bool asleep, double time_debt = 0.0) {
+            state_ = state;
+            system_.UpdateSurface(state_.positions);
+            dropped_ = dropped;
+            if (asleep) {
+                Sleep();
+            }
+            else {
+                Wake();
+                time_debt_ = time_debt;
+            }
+        }
+        double GetTimeDebt() const {
+            return time_debt_;
+        }
+
+        // Advances by delta_time in fixed steps of step_size. Time short of a whole step
+        // carries over to the next call; time beyond max_substeps steps is dropped and
+        // counted in the step stats, so a slow frame cannot snowball into slower ones.
+        void Step(double delta_time) {
+            if (asleep_) {
+                return;
+            }
+            GLOO_ALLOCATION_PHASE("BallSimulation::Step");
+            time_debt_ += delta_time;
+            int substeps = int(time_debt_ / params_.step_size);
+            time_debt_ -= substeps * params_.step_size;
+            if (params_.max_substeps > 0 && substeps > params_.max_substeps) {
+                stats_.dropped_time += (substeps - params_.max_substeps) * params_.step_size;
+                stats_.capped_calls++;
+                substeps = params_.max_substeps;
+            }
+
+            double start_time = 0.0;
+            for (int substep = 0; substep < substeps; substep++) {
+                previous_positions_ = state_.positions;
+                {
+                    GLOO_ALLOCATION_PHASE("Integrator::Integrate");
+                    integrator_->Integrate(system_, state_, start_time, params_.step_size);
+                }
+
+                // ground collisions
+                system_.ResolveGround(state_);
+
+                // surface against itself
+                {
+                    GLOO_ALLOCATION_PHASE("SelfCollision::Resolve");
+                    self_collision_.Resolve(system_.GetInverseMasses(), previous_positions_, state_);
+                }
+
+                // update normals and volume for the pressure force
+                {
+                    GLOO_ALLOCATION_PHASE("PendulumSystem::UpdateSurface");
+                    system_.UpdateSurface(state_.positions);
+                }
+
+                start_time += params_.step_size;
+                if (diagnostics_ != nullptr) {
+                    GLOO_ALLOCATION_PHASE("DiagnosticsRecorder::Record");
+                    diagnostics_->Record(system_, state_, stats_.simulated_time + start_time);
+                }
+            }
+            stats_.simulated_time += substeps * params_.step_size;
+            stats_.last_substeps = substeps;
+            UpdateSleep(delta_time);
+        }
+
+        struct StepStats {
+            double simulated_time = 0.0; // s
+            double dropped_time = 0.0; // s skipped by the substep cap
+            int capped_calls = 0;
+            int last_substeps = 0;
+        };
+        const StepStats& GetStepStats() const {
+            return stats_;
+        }
+        void SetStepStats(const StepStats& stats) {
+            stats_ = stats;
+        }
+        void SetMaxSubsteps(int max_substeps) {
+            params_.max_substeps = max_substeps;
+        }
+
+        // Energies, volume and momentum after every step go to `diagnostics`; nullptr stops recording.
+        void SetDiagnostics(DiagnosticsRecorder* diagnostics) {
+            diagnostics_ = diagnostics;
+        }
+        DiagnosticsRecorder* GetDiagnostics() const {
+            return diagnostics_;
+        }
+
+        // Rest detection: a body that has not been dropped, or whose center of mass
+        // stays put for sleep_window seconds, is not integrated at all until something
+        // wakes it. The ground response kicks contact particles upward on every
+        // step, so a resting ball keeps jittering; the test looks at the bulk
+        // motion over the window, not at the particles' instantaneous velocities.
+        void Wake() {
+            asleep_ = false;
+            rest_time_ = 0.0;
+            time_debt_ = 0.0; // time spent asleep is not owed
+        }
+        bool IsAsleep() const {
+            return asleep_;
+        }
+        bool IsDropped() const {
+            return dropped_;
+        }
+
+        // Bounding sphere and contact response against other bodies (see BodyContact.hpp).
+        // `spheres` holds every body of the scene, this one at index `self`. Held bodies
+        // act as fixed obstacles; a dropped body that is hit wakes up.
+        ContactSphere GetContactSphere() const {
+            return contact::Bound(state_, system_.GetMasses());
+        }
+        size_t ResolveContacts(const std::vector<ContactSphere>& spheres, size_t self) {
+            if (!dropped_) {
+                return 0;
+            }
+            size_t contacts = contact::Resolve(spheres, self, system_.GetInverseMasses(), state_);
+            if (contacts > 0) {
+                system_.UpdateSurface(state_.positions);
+                Wake();
+            }
+            return contacts;
+        }
+
+        void SetGround(const GroundCollider& ground) {
+            system_.SetGround(ground);
+        }
+        const GroundCollider& GetGround() const {
+            return system_.GetGround();
+        }
+
+        const State& GetState() const {
+            return state_;
+        }
+        const std::vector<Vec3>& GetStartPositions() const {
+            return positions_;
+        }
+        const std::vector<glm::vec3>& GetTriangles() const {
+            return triangles_;
+        }
+        const System& GetSystem() const {
+            return system_;
+        }
+        const BallParams& GetParams() const {
+            return params_;
+        }
+        const std::vector<uint32_t>& GetParticleOrder() const {
+            return particle_order_; // new-to-old particle indices
+        }
+
+        // Start positions and surface triangles of a body, numbered like its particles,
+        // without building its springs (e.g. to size buffers for a body simulated elsewhere).
+        // `mesh` is the source surface as given to the constructor, empty for the icosphere.
+        static void BuildTopology(const BallParams& params, Vec3 start_center, SurfaceMeshT<T> mesh, std::vector<Vec3>& positions,
+                                  std::vector<glm::vec3>& triangles) {
+            if (!mesh.positions.empty()) {
+                MeshBodyBuilder<T>::Normalize(mesh);
+            }
+            BuildShape(params, start_center, mesh, positions, triangles);
+            std::vector<uint32_t> order = ordering::ComputeOrder(params.ordering, positions, triangles, 1);
+            ordering::Permute(positions, order);
+            ordering::RenumberTriangles(triangles, order);
+        }
+
+    private:
+        void Init() {
+            integrator_ = IntegratorFactory::CreateIntegrator<System, State>(params_.integrator);
+
+            // initialize body
+            BuildBody();
+            IcosphereBuilder<T>::AddMasses(system_, positions_.size(), T(params_.center_mass), T(params_.vertex_mass),
+                                           params_.center_fixed, params_.vertex_fixed);
+            if (mesh_.positions.empty()) {
+                IcosphereBuilder<T>::AddSprings(system_, positions_, triangles_, T(params_.radial_l()), T(params_.radial_k),
+                                                T(params_.chordal_k), T(params_.surface_k));
+            }
+            else {
+                MeshBodyBuilder<T>::AddSprings(system_, positions_, triangles_, T(params_.surface_k), T(params_.bending_k),
+                                               T(params_.interior_k), params_.interior_chords);
+            }
+            system_.SortSprings();
+            system_.SetTriangles(triangles_);
+            system_.SetDrag(T(params_.b));
+            system_.SetPressureConstant(T(params_.nRT));
+            system_.SetExecutionMode(params_.deterministic ? ExecutionMode::Deterministic : ExecutionMode::Fast);
+            if (params_.self_collision) {
+                self_collision_.Prepare(triangles_, positions_, T(params_.self_collision_thickness));
+            }
+            state_ = { positions_, velocities_ };
+            system_.UpdateSurface(state_.positions);
+            system_.SetRestVolume(system_.GetVolume());
+        }
+        void Sleep() {
+            asleep_ = true;
+            rest_time_ = 0.0;
+        }
+        void UpdateSleep(double delta_time) {
+            if (!dropped_) { // held bodies never need integrating
+                Sleep();
+                return;
+            }
+            const std::vector<T>& masses = system_.GetMasses();
+            T total_mass = T(0);
+            Vec3 center_of_mass(T(0));
+            for (size_t i = 0; i < state_.positions.size(); i++) {
+                center_of_mass += masses[i] * state_.positions[i];
+                total_mass += masses[i];
+            }
+            center_of_mass /= total_mass;
+            if (rest_time_ == 0.0) {
+                rest_anchor_ = center_of_mass; // a new window starts here
+            }
+
+            // the window lasts while the center of mass stays within sleep_speed * sleep_window of its start
+            T drift = glm::length(center_of_mass - rest_anchor_);
+            if (drift >= T(params_.sleep_speed * params_.sleep_window)) {
+                rest_time_ = 0.0;
+                return;
+            }
+            rest_time_ += delta_time;
+            if (rest_time_ >= params_.sleep_window) {
+                // and the mean motion over it carries less than sleep_kinetic_energy
+                T mean_speed = drift / T(rest_time_);
+                if (T(0.5) * total_mass * mean_speed * mean_speed < T(params_.sleep_kinetic_energy)) {
+                    Sleep();
+                }
+                else {
+                    rest_time_ = 0.0;
+                }
+            }
+        }
+        static void BuildShape(const BallParams& params, Vec3 center, const SurfaceMeshT<T>& mesh, std::vector<Vec3>& positions,
+                               std::vector<glm::vec3>& triangles) {
+            if (mesh.positions.empty()) {
+                IcosphereBuilder<T>(params.subdivisions, params.surface_layers).Build(center, T(params.scale), positions, triangles);
+            }
+            else { // same bounding radius as the icosphere
+                MeshBodyBuilder<T>::Build(mesh, center, T(params.radial_l()), positions, triangles);
+            }
+        }
+        void BuildBody() {
+            BuildShape(params_, start_center_, mesh_, positions_, triangles_);
+
+            // renumber for cache locality; the order is fixed at construction so resets keep matching the springs
+            if (particle_order_.empty()) {
+                particle_order_ = ordering::ComputeOrder(params_.ordering, positions_, triangles_, 1);
+            }
+            ordering::Permute(positions_, particle_order_);
+            ordering::RenumberTriangles(triangles_, particle_order_);
+            velocities_.assign(positions_.size(), Vec3(T(0)));
+        }
+
+        BallParams params_;
+        Vec3 start_center_;
+        SurfaceMeshT<T> mesh_; // normalized source surface; empty for the icosphere
+        std::vector<uint32_t> particle_order_; // new-to-old particle indices (center stays at index 0)
+
+        // SIMULATION INFO
+        std::vector<Vec3> positions_;
+        std::vector<Vec3> velocities_;
+        std::vector<glm::vec3> triangles_;
+        State state_;
+        System system_;
+        std::unique_ptr<IntegratorBase<System, State>> integrator_;
+        SelfCollisionT<T> self_collision_; // left unprepared when disabled
+        std::vector<Vec3> previous_positions_; // positions at the start of the current substep
+        DiagnosticsRecorder* diagnostics_ = nullptr; // not owned
+
+        // SLEEP STATE
+        bool dropped_ = false;
+        bool asleep_ = true;
+        double rest_time_ = 0.0; // seconds into the current rest window
+        Vec3 rest_anchor_ = Vec3(T(0)); // center of mass where the window started
+
+        // STEP PACING
+        double time_debt_ = 0.0; // requested time not yet integrated (less than one step)
+        StepStats stats_;
+    };
+
+    using BallSimulation = BallSimulationT<float>;
+}  // namespace GLOO
+
+#endif
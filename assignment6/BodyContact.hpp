@@ -0,0 +1,126 @@
+#ifndef BODY_CONTACT_H_
+#define BODY_CONTACT_H_
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ParticleState.hpp"
+
+
+namespace GLOO {
+    // Bounding sphere of a body, the only data bodies exchange to collide with
+    // each other. Plain floats so it can be copied between processes as is.
+    struct ContactSphere {
+        glm::vec3 center = glm::vec3(0.f); // mean of the surface particles
+        float radius = 0.f;
+        glm::vec3 velocity = glm::vec3(0.f); // mass-weighted mean
+        float mass = 0.f;
+    };
+
+    // Body-body contact between bounding-sphere proxies. Where two spheres
+    // overlap, the contact plane sits in the middle of the overlap; each body
+    // projects its particles that crossed the plane back onto it and removes
+    // their velocity into the plane, relative to the pair's mass-weighted mean
+    // velocity. Both bodies flatten against the plane and their springs and
+    // pressure push them apart. Coarse for bodies far from round, but a body
+    // only needs the other's sphere, never its particles.
+    namespace contact {
+        inline bool IsFinite(const ContactSphere& sphere) {
+            return std::isfinite(sphere.center.x) && std::isfinite(sphere.center.y) && std::isfinite(sphere.center.z) &&
+                   std::isfinite(sphere.radius) && std::isfinite(sphere.velocity.x) &&
+                   std::isfinite(sphere.velocity.y) && std::isfinite(sphere.velocity.z) && std::isfinite(sphere.mass);
+        }
+
+        // Mean of the surface particles. The center particle hangs free without radial
+        // springs (radial_k 0) and sinks to the ground, so it is left out.
+        template <class T>
+        glm::vec<3, T> SurfaceCenter(const std::vector<glm::vec<3, T>>& positions) {
+            size_t first = positions.size() > 1 ? 1 : 0;
+            glm::vec<3, T> center(T(0));
+            for (size_t i = first; i < positions.size(); i++) {
+                center += positions[i];
+            }
+            return positions.empty() ? center : center / T(positions.size() - first);
+        }
+
+        template <class T>
+        ContactSphere Bound(const ParticleStateT<T>& state, const std::vector<T>& masses) {
+            ContactSphere sphere;
+            if (state.positions.empty()) {
+                return sphere;
+            }
+            // the sphere bounds the surface particles alone (see SurfaceCenter)
+            size_t first = state.positions.size() > 1 ? 1 : 0;
+            glm::vec<3, T> center = SurfaceCenter(state.positions);
+            T radius = T(0);
+            for (size_t i = first; i < state.positions.size(); i++) {
+                T distance = glm::length(state.positions[i] - center);
+                if (!(distance <= radius)) {
+                    radius = distance; // not std::max, which would drop a NaN
+                }
+            }
+            glm::vec<3, T> momentum(T(0));
+            T total_mass = T(0);
+            for (size_t i = 0; i < state.positions.size(); i++) {
+                momentum += masses[i] * state.velocities[i];
+                total_mass += masses[i];
+            }
+            sphere.center = glm::vec3(center);
+            sphere.radius = float(radius);
+            sphere.velocity = total_mass > T(0) ? glm::vec3(momentum / total_mass) : glm::vec3(0.f);
+            sphere.mass = float(total_mass);
+            return sphere;
+        }
+
+        // Resolves `state` (the body at index `self`) against every other sphere
+        // it overlaps. Returns the number of corrected particles.
+        template <class T>
+        size_t Resolve(const std::vector<ContactSphere>& spheres, size_t self, const std::vector<T>& inverse_masses,
+                       ParticleStateT<T>& state) {
+            using Vec3 = glm::vec<3, T>;
+            const ContactSphere& own = spheres[self];
+            size_t contacts = 0;
+            if (!IsFinite(own)) {
+                return contacts;
+            }
+            for (size_t b = 0; b < spheres.size(); b++) {
+                const ContactSphere& other = spheres[b];
+                if (b == self || !IsFinite(other)) {
+                    continue; // a diverged body must not spread its NaNs to the others
+                }
+                T distance = T(glm::length(other.center - own.center));
+                T depth = T(own.radius) + T(other.radius) - distance;
+                if (!(depth > T(0)) || !(distance > T(0))) {
+                    continue; // broad phase
+                }
+                if (depth > T(std::min(own.radius, other.radius))) {
+                    continue; // overlapping by more than a radius: tunnelled, or a body blowing up
+                }
+                Vec3 normal = Vec3(other.center - own.center) / distance; // toward the other body
+                Vec3 plane = Vec3(own.center) + (T(own.radius) - depth / T(2)) * normal;
+                T pair_mass = T(own.mass) + T(other.mass);
+                Vec3 plane_velocity = pair_mass > T(0)
+                    ? (T(own.mass) * Vec3(own.velocity) + T(other.mass) * Vec3(other.velocity)) / pair_mass
+                    : Vec3(T(0));
+                for (size_t i = 0; i < state.positions.size(); i++) {
+                    T crossed = glm::dot(state.positions[i] - plane, normal);
+                    if (!(crossed > T(0)) || inverse_masses[i] == T(0)) {
+                        continue;
+                    }
+                    state.positions[i] -= crossed * normal;
+                    T approach = glm::dot(state.velocities[i] - plane_velocity, normal);
+                    if (approach > T(0)) {
+                        state.velocities[i] -= approach * normal;
+                    }
+                    contacts++;
+                }
+            }
+            return contacts;
+        }
+    }  // namespace contact
+}  // namespace GLOO
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef CONTACT_NODE_H_
+#define CONTACT_NODE_H_
+
+#include <vector>
+
+#include "gloo/SceneNode.hpp"
+#include "BallNode.hpp"
+#include "SceneStep.hpp"
+
+
+namespace GLOO {
+    // Body-body contacts of the app's balls, with the SceneStep exchange the
+    // headless runs use. The ball nodes step themselves by the frame time, so
+    // the exchange runs once per frame; added to the scene before the balls,
+    // it resolves the previous frame's overlaps before they step and redraw.
+    class ContactNode : public SceneNode {
+    public:
+        void AddBall(BallNode* ball) {
+            bodies_.push_back(&ball->GetSimulation());
+        }
+
+        void Update(double) override {
+            if (bodies_.size() > 1) {
+                step_.Exchange(bodies_);
+            }
+        }
+
+    private:
+        std::vector<MultiResolutionBall*> bodies_;
+        SceneStep step_;
+    };
+}  // namespace GLOO
+
+#endif
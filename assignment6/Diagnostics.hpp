@@ -0,0 +1,200 @@
+#ifndef DIAGNOSTICS_H_
+#define DIAGNOSTICS_H_
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ParticleState.hpp"
+#include "PendulumSystem.hpp"
+#include "ThreadPool.hpp"
+
+
+namespace GLOO {
+    // One snapshot of the energies, volume and momentum of a body. The total
+    // leaves out the gas's energy, so it swings while the ball compresses, but
+    // with drag it should never grow: a rising total, or momentum changing
+    // faster than gravity allows in flight, flags an unstable step size well
+    // before the ball visibly explodes.
+    struct DiagnosticsSample {
+        double time = 0.0;
+        double kinetic = 0.0;
+        double gravitational = 0.0; // relative to y = 0
+        double spring = 0.0;
+        double total = 0.0;
+        double volume = 0.0;
+        glm::dvec3 momentum = glm::dvec3(0.0);
+    };
+
+    namespace diagnostics {
+        const size_t kGrain = 2048;
+
+        // Sums term(begin, end) over fixed chunks of [0, count) in parallel. The chunk
+        // partials are added in chunk order, so the result does not depend on scheduling.
+        // Each term is a plain indexed loop the compiler can vectorize. `partials` is
+        // scratch space the caller keeps, so repeated reductions do not allocate.
+        template <class TTerm>
+        double Reduce(size_t count, std::vector<double>& partials, const TTerm& term) {
+            partials.assign((count + kGrain - 1) / kGrain, 0.0);
+            ThreadPool::GetInstance().ParallelFor(count, kGrain, [&](size_t begin, size_t end) {
+                partials[begin / kGrain] = term(begin, end);
+            });
+            double sum = 0.0;
+            for (double partial : partials) {
+                sum += partial;
+            }
+            return sum;
+        }
+
+        template <class T>
+        DiagnosticsSample Measure(const PendulumSystemT<T>& system, const ParticleStateT<T>& state, double time,
+                                  std::vector<double>& partials) {
+            using Vec3 = glm::vec<3, T>;
+            const std::vector<T>& m = system.GetMasses();
+            const std::vector<Vec3>& x = state.positions;
+            const std::vector<Vec3>& v = state.velocities;
+            const Vec3 g = system.GetGravity();
+            size_t n = x.size();
+
+            DiagnosticsSample sample;
+            sample.time = time;
+            sample.kinetic = Reduce(n, partials, [&](size_t begin, size_t end) {
+                T sum = T(0);
+                for (size_t i = begin; i < end; i++) {
+                    sum += m[i] * (v[i].x * v[i].x + v[i].y * v[i].y + v[i].z * v[i].z);
+                }
+                return double(sum) / 2.0;
+            });
+            sample.gravitational = Reduce(n, partials, [&](size_t begin, size_t end) {
+                T sum = T(0);
+                for (size_t i = begin; i < end; i++) {
+                    sum -= m[i] * (g.x * x[i].x + g.y * x[i].y + g.z * x[i].z);
+                }
+                return double(sum);
+            });
+            for (int axis = 0; axis < 3; axis++) {
+                sample.momentum[axis] = Reduce(n, partials, [&](size_t begin, size_t end) {
+                    T sum = T(0);
+                    for (size_t i = begin; i < end; i++) {
+                        sum += m[i] * v[i][axis];
+                    }
+                    return double(sum);
+                });
+            }
+            for (const SpringGroupT<T>& group : system.GetSpringGroups()) {
+                const T k = group.k;
+                sample.spring += Reduce(group.size(), partials, [&](size_t begin, size_t end) {
+                    T sum = T(0);
+                    for (size_t s = begin; s < end; s++) {
+                        T stretch = glm::length(x[group.first[s]] - x[group.second[s]]) - group.rest_lengths[s];
+                        sum += stretch * stretch;
+                    }
+                    return double(k * sum) / 2.0;
+                });
+            }
+            sample.total = sample.kinetic + sample.gravitational + sample.spring;
+            sample.volume = double(system.GetVolume());
+            return sample;
+        }
+    }  // namespace diagnostics
+
+    // Keeps the most recent samples as per-channel rings for plotting and,
+    // optionally, appends every sample to a CSV file. A BallSimulation given
+    // a recorder (SetDiagnostics) records one sample per integration step.
+    class DiagnosticsRecorder {
+    public:
+        enum Channel { kKinetic, kGravitational, kSpring, kTotal, kVolume, kMomentumX, kMomentumY, kMomentumZ, kChannelCount };
+
+        explicit DiagnosticsRecorder(size_t capacity = 4096) : capacity_(capacity) {
+            for (std::vector<float>& ring : rings_) {
+                ring.assign(capacity_, 0.f);
+            }
+        }
+
+        static const char* ChannelName(int channel) {
+            static const char* const names[kChannelCount] = {
+                "kinetic", "gravitational", "spring", "total", "volume", "momentum_x", "momentum_y", "momentum_z"
+            };
+            return names[channel];
+        }
+
+        template <class T>
+        void Record(const PendulumSystemT<T>& system, const ParticleStateT<T>& state, double time) {
+            Push(diagnostics::Measure(system, state, time, partials_));
+        }
+
+        void Push(const DiagnosticsSample& sample) {
+            const double values[kChannelCount] = {
+                sample.kinetic, sample.gravitational, sample.spring, sample.total, sample.volume,
+                sample.momentum.x, sample.momentum.y, sample.momentum.z
+            };
+            for (int c = 0; c < kChannelCount; c++) {
+                rings_[c][next_] = float(values[c]);
+            }
+            next_ = (next_ + 1) % capacity_;
+            count_ = count_ < capacity_ ? count_ + 1 : capacity_;
+            last_ = sample;
+
+            if (csv_.is_open()) {
+                csv_ << sample.time;
+                for (double value : values) {
+                    csv_ << ',' << value;
+                }
+                csv_ << '\n';
+            }
+        }
+
+        void Clear() {
+            next_ = 0;
+            count_ = 0;
+        }
+
+        // CSV streaming; returns false if the file cannot be opened
+        bool StartCsv(const std::string& filename) {
+            csv_.close();
+            csv_.open(filename);
+            if (!csv_.is_open()) {
+                return false;
+            }
+            csv_ << "time";
+            for (int c = 0; c < kChannelCount; c++) {
+                csv_ << ',' << ChannelName(c);
+            }
+            csv_ << '\n';
+            return true;
+        }
+        void StopCsv() {
+            csv_.close();
+        }
+        bool IsStreaming() const {
+            return csv_.is_open();
+        }
+
+        // ring data for ImGui::PlotLines(label, GetRing(c), GetCount(), GetOffset())
+        const float* GetRing(int channel) const {
+            return rings_[channel].data();
+        }
+        int GetCount() const {
+            return int(count_);
+        }
+        int GetOffset() const {
+            return count_ < capacity_ ? 0 : int(next_); // oldest sample
+        }
+        const DiagnosticsSample& GetLast() const {
+            return last_;
+        }
+
+    private:
+        size_t capacity_;
+        size_t next_ = 0;
+        size_t count_ = 0;
+        std::vector<float> rings_[kChannelCount];
+        DiagnosticsSample last_;
+        std::vector<double> partials_; // chunk sums of the reductions, reused across samples
+        std::ofstream csv_;
+    };
+}  // namespace GLOO
+
+#endif
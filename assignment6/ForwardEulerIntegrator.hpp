@@ -7,16 +7,17 @@
 namespace GLOO {
 template <class TSystem, class TState>
 class ForwardEulerIntegrator : public IntegratorBase<TSystem, TState> {
-  TState Integrate(const TSystem& system,
-                   const TState& state,
-                   float start_time,
-                   float dt) const override {
-    // TODO: Here we are returning the state at time t (which is NOT what we
-    // want). Please replace the line below by the state at time t + dt using
-    // forward Euler integration.
-    TState new_state = state + dt * system.ComputeTimeDerivative(state, start_time);
-    return new_state;
+  void Integrate(const TSystem& system,
+                 TState& state,
+                 float start_time,
+                 float dt) const override {
+    // forward Euler: x(t + dt) = x(t) + dt * f(x(t))
+    typename TState::Scalar h = dt; // step in the state's precision
+    system.ComputeTimeDerivative(state, start_time, f_);
+    state.AddScaled(h, f_);
   }
+
+  mutable TState f_; // derivative scratch, reused across steps
 };
 }  // namespace GLOO
 
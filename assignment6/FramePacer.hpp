@@ -0,0 +1,51 @@
+#ifndef FRAME_PACER_H_
+#define FRAME_PACER_H_
+
+#include <chrono>
+#include <thread>
+
+
+namespace GLOO {
+    // Caps the main loop's frame rate by sleeping until the next frame is due,
+    // instead of spinning a core. A loop that falls more than a frame behind
+    // restarts its schedule rather than rushing to catch up.
+    class FramePacer {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        explicit FramePacer(double max_fps) : next_frame_(Clock::now()) {
+            SetMaxFps(max_fps);
+        }
+
+        // 0 disables the cap
+        void SetMaxFps(double max_fps) {
+            max_fps_ = max_fps;
+            if (max_fps > 0.0) {
+                period_ = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / max_fps));
+            }
+        }
+        double GetMaxFps() const {
+            return max_fps_;
+        }
+
+        void WaitForNextFrame() {
+            if (max_fps_ <= 0.0) {
+                return;
+            }
+            next_frame_ += period_;
+            Clock::time_point now = Clock::now();
+            if (next_frame_ + period_ < now) {
+                next_frame_ = now; // too far behind to catch up
+                return;
+            }
+            std::this_thread::sleep_until(next_frame_);
+        }
+
+    private:
+        double max_fps_ = 0.0;
+        Clock::duration period_ = Clock::duration::zero();
+        Clock::time_point next_frame_;
+    };
+}  // namespace GLOO
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef GROUND_COLLIDER_H_
+#define GROUND_COLLIDER_H_
+
+#include <glm/glm.hpp>
+
+
+namespace GLOO {
+    // Axis-aligned ground rectangle at height `height`, shared by GroundNode (rendering)
+    // and the headless simulation (collision).
+    struct GroundCollider {
+        float height = 0.0; // y
+        float left_edge = -5.0; // -x
+        float right_edge = 5.0; // +x
+        float back_edge = -5.0; // -z
+        float front_edge = 5.0; // +z
+
+        template <class TVec3>
+        bool InBounds(const TVec3& position, float eps) const {
+            if (position.y+eps < height) {
+                if (position.x+eps > left_edge && position.x+eps < right_edge) {
+                    if (position.z+eps > back_edge && position.z+eps < front_edge) {
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        // Contact response of one particle: once it sinks more than eps below the
+        // surface it is kicked upward at 1 m/s, whatever its velocity was. Returns
+        // whether the particle was in contact.
+        template <class T>
+        bool Resolve(const glm::vec<3, T>& position, glm::vec<3, T>& velocity, float eps) const {
+            if (!InBounds(position, eps)) {
+                return false;
+            }
+            velocity = glm::vec<3, T>(T(0), T(1), T(0));
+            return true;
+        }
+    };
+} // namespace GLOO
+
+#endif
@@ -6,21 +6,22 @@
 #include "gloo/components/RenderingComponent.hpp"
 #include "gloo/components/ShadingComponent.hpp"
 #include "gloo/shaders/PhongShader.hpp"
+#include "GroundCollider.hpp"
 #include <glm/gtx/string_cast.hpp>
 
 
 namespace GLOO {
     class GroundNode : public SceneNode {
     public:
-        GroundNode() {
+        explicit GroundNode(const GroundCollider& collider = GroundCollider()) : collider_(collider) {
             auto normal_positions = make_unique<PositionArray>();
             auto normal_indicies = make_unique<IndexArray>();
             auto normals = make_unique<NormalArray>();
 
-            positions_.push_back(glm::vec3(left_edge_, height_, back_edge_));
-            positions_.push_back(glm::vec3(left_edge_, height_, front_edge_));
-            positions_.push_back(glm::vec3(right_edge_, height_, back_edge_));
-            positions_.push_back(glm::vec3(right_edge_, height_, front_edge_));
+            positions_.push_back(glm::vec3(collider_.left_edge, collider_.height, collider_.back_edge));
+            positions_.push_back(glm::vec3(collider_.left_edge, collider_.height, collider_.front_edge));
+            positions_.push_back(glm::vec3(collider_.right_edge, collider_.height, collider_.back_edge));
+            positions_.push_back(glm::vec3(collider_.right_edge, collider_.height, collider_.front_edge));
             for (glm::vec3 position : positions_) {
                 normal_positions->push_back(position);
             }
@@ -47,23 +48,16 @@ namespace GLOO {
         }
 
         bool InBounds(glm::vec3 position, float eps) {
-            if (position.y+eps < height_) {
-                if (position.x+eps > left_edge_ && position.x+eps < right_edge_) {
-                    if (position.z+eps > back_edge_ && position.z+eps < front_edge_) {
-                        return true;
-                    }
-                }
-            }
-            return false;
+            return collider_.InBounds(position, eps);
+        }
+
+        const GroundCollider& GetCollider() const {
+            return collider_;
         }
 
 
     private:
-        float height_ = 0.0; // y
-        float left_edge_ = -5.0; // -x
-        float right_edge_ = 5.0; // +x
-        float back_edge_ = -5.0; // -z
-        float front_edge_ = 5.0; // +z
+        GroundCollider collider_;
         std::vector<glm::vec3> positions_;
 
         std::shared_ptr<VertexObject> normal_mesh_ = std::make_shared<VertexObject>();
@@ -0,0 +1,285 @@
+#ifndef ICOSPHERE_BUILDER_H_
+#define ICOSPHERE_BUILDER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "SpringGroup.hpp"
+#include "ThreadPool.hpp"
+
+
+namespace GLOO {
+    // Builds the soft-body icosphere used by BallNode: a center particle at
+    // index 0 surrounded by a subdivided icosahedron. Kept free of scene-graph
+    // types so headless tools can construct the same body at any precision.
+    template <class T>
+    class IcosphereBuilder {
+    public:
+        using Vec3 = glm::vec<3, T>;
+
+        IcosphereBuilder(int subdivisions, int surface_layers)
+            : subdivisions_(subdivisions), surface_layers_(surface_layers) {
+        }
+
+        // Vertices are numbered coarse to fine: the first vertices of a level-n sphere are
+        // exactly the vertices of the level-(n-1) sphere. If `parents` is given, it receives
+        // the edge endpoints each midpoint vertex was created from (zeros for the center
+        // and the 12 icosahedron vertices).
+        void Build(Vec3 center, T scale, std::vector<Vec3>& positions, std::vector<glm::vec3>& triangles,
+                   std::vector<glm::uvec2>* parents = nullptr) {
+            positions_ = &positions;
+            triangles_ = &triangles;
+            parents_ = parents;
+            positions.clear();
+            triangles.clear();
+            if (parents) {
+                parents->clear();
+            }
+            InitIcosahedron(center, scale);
+            SubdivideToIcosphere();
+            positions_ = nullptr;
+            triangles_ = nullptr;
+            parents_ = nullptr;
+        }
+
+        // Number of particles (center included) of a single-layer sphere at `subdivisions`.
+        static size_t ParticleCount(int subdivisions) {
+            return 1 + 10 * (size_t(1) << (2 * subdivisions)) + 2;
+        }
+
+        // Places a midpoint vertex from its two parents the same way the builder does:
+        // at the mean parent distance from the center, along the direction of their sum.
+        static Vec3 Midpoint(const Vec3& center, const Vec3& p0, const Vec3& p1) {
+            Vec3 v0 = p0 - center;
+            Vec3 v1 = p1 - center;
+            return glm::normalize(v0 + v1) * (glm::length(v0) + glm::length(v1)) / T(2) + center;
+        }
+
+        template <class TSystem>
+        static void AddMasses(TSystem& system, size_t count, T center_mass, T vertex_mass, bool center_fixed, bool vertex_fixed) {
+            system.AddMass(center_mass, center_fixed);
+            for (size_t i = 1; i < count; i++) {
+                system.AddMass(vertex_mass, vertex_fixed);
+            }
+        }
+
+        // Springs are written straight into preallocated groups, the chords and surface
+        // edges from all pool threads. Chords come out in the order SortSprings would give
+        // them, so it can skip them; at subdivision 4 they are over three million.
+        template <class TSystem>
+        static void AddSprings(TSystem& system, const std::vector<Vec3>& positions, const std::vector<glm::vec3>& triangles,
+                               T radial_l, T radial_k, T chordal_k, T surface_k) {
+            const size_t n = positions.size();
+            ThreadPool& pool = ThreadPool::GetInstance();
+
+            // radial springs (skipped entirely when they carry no stiffness)
+            if (radial_k != T(0)) {
+                SpringGroupT<T>& radial = system.AddSpringGroupOfSize(SpringKind::Radial, radial_k, n - 1);
+                for (size_t i = 1; i < n; i++) {
+                    radial.first[i - 1] = 0;
+                    radial.second[i - 1] = uint32_t(i);
+                    radial.rest_lengths[i - 1] = radial_l;
+                }
+            }
+
+            // chordal springs: every pair a < b of surface particles, row by row
+            SpringGroupT<T>& chordal = system.AddSpringGroupOfSize(SpringKind::Chordal, chordal_k, (n - 1) * (n - 2) / 2);
+            pool.ParallelFor(chordal.size(), kSpringGrain, [&](size_t begin, size_t end) {
+                size_t a = ChordRow(n, begin);
+                size_t b = a + 1 + (begin - ChordRowStart(n, a));
+                for (size_t s = begin; s < end; s++) {
+                    chordal.first[s] = uint32_t(a);
+                    chordal.second[s] = uint32_t(b);
+                    chordal.rest_lengths[s] = glm::length(positions[b] - positions[a]);
+                    if (++b == n) {
+                        a++;
+                        b = a + 1;
+                    }
+                }
+            });
+
+            // surface springs (one per triangle edge, so interior edges are counted by both neighbours)
+            SpringGroupT<T>& surface = system.AddSpringGroupOfSize(SpringKind::Surface, surface_k, 3 * triangles.size());
+            pool.ParallelFor(triangles.size(), kSpringGrain / 3, [&](size_t begin, size_t end) {
+                for (size_t t = begin; t < end; t++) {
+                    for (int c = 0; c < 3; c++) {
+                        uint32_t i = uint32_t(triangles[t][c]);
+                        uint32_t j = uint32_t(triangles[t][(c + 1) % 3]);
+                        surface.first[3 * t + c] = i;
+                        surface.second[3 * t + c] = j;
+                        surface.rest_lengths[3 * t + c] = glm::length(positions[j] - positions[i]);
+                    }
+                }
+            });
+        }
+
+    private:
+        static const size_t kSpringGrain = 1 << 14;
+
+        // first chord index of row a (the pairs (a, b) with b > a) among particles 1..n-1
+        static size_t ChordRowStart(size_t n, size_t a) {
+            return (a - 1) * (n - 1) - (a - 1) * a / 2;
+        }
+        static size_t ChordRow(size_t n, size_t s) {
+            size_t low = 1;
+            size_t high = n - 2; // last row with a chord
+            while (low < high) {
+                size_t middle = (low + high + 1) / 2;
+                if (ChordRowStart(n, middle) <= s) {
+                    low = middle;
+                }
+                else {
+                    high = middle - 1;
+                }
+            }
+            return low;
+        }
+
+        void InitIcosahedron(Vec3 center, T scale) {
+            // center
+            positions_->push_back(icosa_vertices_[0] * scale + center);
+
+            // 12 vertices
+            for (int i = 1; i <= 12; i++) {
+                positions_->push_back(icosa_vertices_[i] * scale + center);
+            }
+
+            // 20 faces
+            for (glm::vec3 face : icosa_faces_) {
+                triangles_->push_back(face + glm::vec3(1, 1, 1)); // adjust indices by one since center is at index 0
+            }
+        }
+        void SubdivideToIcosphere() {
+            // http://www.songho.ca/opengl/gl_sphere.html
+            //         v0
+            //        / \      v0, v1, v2: corners of the original face
+            //    v3 *---* v5
+            //      / \ / \    v3, v4, v5: midpoints of its edges
+            //    v1---*---v2
+            //         v4
+            std::vector<glm::vec3>& triangles = *triangles_;
+            for (int n = 0; n < subdivisions_ - surface_layers_ + 1; n++) { // final icosphere only includes last layer of this loop
+                std::vector<glm::vec3> temp_triangles;
+                for (glm::vec3 triangle : triangles) {
+                    // original vertices
+                    int i0 = triangle[0];
+                    int i1 = triangle[1];
+                    int i2 = triangle[2];
+
+                    // new vertices
+                    int i3 = AddMidpoint(i0, i1);
+                    int i4 = AddMidpoint(i1, i2);
+                    int i5 = AddMidpoint(i2, i0);
+
+                    // new faces
+                    temp_triangles.push_back(glm::vec3(i0, i3, i5));
+                    temp_triangles.push_back(glm::vec3(i3, i1, i4));
+                    temp_triangles.push_back(glm::vec3(i5, i4, i2));
+                    temp_triangles.push_back(glm::vec3(i3, i4, i5));
+                }
+                midpt_cache_.clear();
+                triangles = temp_triangles;
+            }
+            std::vector<glm::vec3> new_triangles = triangles; // if surface_layers == subdivisions_ + 1, then this is original triangles (otherwise, comes from previous loop)
+            for (int n = subdivisions_ - surface_layers_ + 1; n < subdivisions_; n++) {
+                for (glm::vec3 triangle : triangles) {
+                    // original vertices
+                    int i0 = triangle[0];
+                    int i1 = triangle[1];
+                    int i2 = triangle[2];
+
+                    // new vertices
+                    int i3 = AddMidpoint(i0, i1);
+                    int i4 = AddMidpoint(i1, i2);
+                    int i5 = AddMidpoint(i2, i0);
+
+                    // new faces
+                    new_triangles.push_back(glm::vec3(i0, i3, i5));
+                    new_triangles.push_back(glm::vec3(i3, i1, i4));
+                    new_triangles.push_back(glm::vec3(i5, i4, i2));
+                    new_triangles.push_back(glm::vec3(i3, i4, i5));
+                }
+                midpt_cache_.clear();
+                triangles = new_triangles;
+            }
+        }
+        int AddMidpoint(int i0, int i1) {
+            std::vector<Vec3>& positions = *positions_;
+            int i2 = GetMidpointIndex(i0, i1);
+            if (i2 == int(positions.size())) {
+                positions.push_back(Midpoint(positions[0], positions[i0], positions[i1]));
+                if (parents_) {
+                    parents_->resize(positions.size() - 1, glm::uvec2(0));
+                    parents_->push_back(glm::uvec2(i0, i1));
+                }
+            }
+            return i2;
+        }
+        int GetMidpointIndex(int i0, int i1) { // indices of endpts
+            uint64_t key = (uint64_t(std::min(i0, i1)) << 32) | uint64_t(std::max(i0, i1)); // unordered pair (i0, i1)
+            auto search = midpt_cache_.find(key);
+            if (search == midpt_cache_.end()) { // midpoint is a new vertex
+                midpt_cache_.insert({ key, int(positions_->size()) });
+                return positions_->size();
+            }
+            else {
+                return search->second; // midpoint is already a vertex
+            }
+        }
+
+        int subdivisions_;
+        int surface_layers_; // must have 1 <= surface_layers_ <= subdivisions_ + 1
+        std::vector<Vec3>* positions_ = nullptr;
+        std::vector<glm::vec3>* triangles_ = nullptr;
+        std::vector<glm::uvec2>* parents_ = nullptr;
+        std::unordered_map<uint64_t, int> midpt_cache_;
+
+        // http://blog.andreaskahler.com/2009/06/creating-icosphere-mesh-in-code.html
+        // ICOSAHEDRON DATA (edge length 2)
+        const T t_ = (T(1) + std::sqrt(T(5))) / T(2);
+        const std::vector<Vec3> icosa_vertices_{ // (x,y,z) coords for each vertex of nontransformed icosahedron
+            Vec3(0.f, 0.f, 0.f), // center
+            Vec3(-1.f, t_, 0.f), // 12 vertices
+            Vec3(1.f, t_, 0.f),
+            Vec3(-1.f, -t_, 0.f),
+            Vec3(1.f, -t_, 0.f),
+            Vec3(0.f, -1.f, t_),
+            Vec3(0.f, 1.f, t_),
+            Vec3(0.f, -1.f, -t_),
+            Vec3(0.f, 1.f, -t_),
+            Vec3(t_, 0.f, -1),
+            Vec3(t_, 0.f, 1.f),
+            Vec3(-t_, 0.f, -1),
+            Vec3(-t_, 0.f, 1.f),
+        };
+        const std::vector<glm::vec3> icosa_faces_{ // (i,j,k) vertex indices for each face of icosahedron
+            glm::vec3(0, 11, 5),                   // indexed by 0 (notice icosa_vertices_ are indexed by 1
+            glm::vec3(0, 5, 1),                    // since the center is at the 0th index)
+            glm::vec3(0, 1, 7),
+            glm::vec3(0, 7, 10),
+            glm::vec3(0, 10, 11),
+            glm::vec3(1, 5, 9),
+            glm::vec3(5, 11, 4),
+            glm::vec3(11, 10, 2),
+            glm::vec3(10, 7, 6),
+            glm::vec3(7, 1, 8),
+            glm::vec3(3, 9, 4),
+            glm::vec3(3, 4, 2),
+            glm::vec3(3, 2, 6),
+            glm::vec3(3, 6, 8),
+            glm::vec3(3, 8, 9),
+            glm::vec3(4, 9, 5),
+            glm::vec3(2, 4, 11),
+            glm::vec3(6, 2, 10),
+            glm::vec3(8, 6, 7),
+            glm::vec3(9, 8, 1),
+        };
+    };
+}  // namespace GLOO
+
+#endif
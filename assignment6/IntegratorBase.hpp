@@ -10,10 +10,12 @@ class IntegratorBase {
         virtual ~IntegratorBase() {
         } 
 
-        virtual TState Integrate(const TSystem& system,
-                                const TState& state,
-                                float start_time,
-                                float dt) const = 0;
+        // Advances `state` from start_time to start_time + dt in place, so
+        // intermediate states can live in buffers the integrator reuses.
+        virtual void Integrate(const TSystem& system,
+                               TState& state,
+                               float start_time,
+                               float dt) const = 0;
 };
 }  // namespace GLOO
 
@@ -7,6 +7,8 @@
 #include "ForwardEulerIntegrator.hpp"
 #include "TrapezoidalIntegrator.hpp"
 #include "RK4Integrator.hpp"
+#include "XPBDIntegrator.hpp"
+#include "MultiRateIntegrator.hpp"
 
 namespace GLOO {
 class IntegratorFactory {
@@ -19,7 +21,12 @@ class IntegratorFactory {
         return make_unique<TrapezoidalIntegrator<TSystem, TState>>();
       } else if (type == IntegratorType::RK4) {
         return make_unique<RK4Integrator<TSystem, TState>>();
+      } else if (type == IntegratorType::XPBD) {
+        return make_unique<XPBDIntegrator<TSystem, TState>>();
+      } else if (type == IntegratorType::MultiRate) {
+        return make_unique<MultiRateIntegrator<TSystem, TState>>();
       }
+      throw std::runtime_error("Unknown integrator type " + std::to_string(int(type)) + ".");
     }
 };
 }  // namespace GLOO
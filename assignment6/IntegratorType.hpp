@@ -2,7 +2,7 @@
 #define INTEGRATOR_TYPE_H_
 
 namespace GLOO {
-enum class IntegratorType { Euler, Trapezoidal, RK4 };
+enum class IntegratorType { Euler, Trapezoidal, RK4, XPBD, MultiRate };
 }
 
 #endif
@@ -0,0 +1,291 @@
+#ifndef MESH_BODY_BUILDER_H_
+#define MESH_BODY_BUILDER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ParticleOrdering.hpp"
+#include "SpringGroup.hpp"
+
+
+namespace GLOO {
+    // Closed triangle surface, with vertices shared between faces.
+    template <class T>
+    struct SurfaceMeshT {
+        std::vector<glm::vec<3, T>> positions;
+        std::vector<glm::vec3> triangles; // (i,j,k) vertex indices
+    };
+
+    // Builds a soft body from an arbitrary closed triangle mesh, laid out like
+    // the icosphere: a center particle at index 0, then the surface vertices.
+    // Springs come from a deduplicated edge table built by radix-sorting the
+    // half-edges, so construction is linear in the face count:
+    //   structural  one per mesh edge (surface_k),
+    //   bending     between the opposite vertices of the two faces sharing
+    //               an edge (bending_k),
+    //   interior    center spokes plus `interior_chords` chords per vertex
+    //               across the body (interior_k).
+    // The surface triangles feed the same pressure model as the icosphere.
+    template <class T>
+    class MeshBodyBuilder {
+    public:
+        using Vec3 = glm::vec<3, T>;
+        using Mesh = SurfaceMeshT<T>;
+
+        // Merges vertices with identical positions (OBJ importers split them at
+        // texture and normal seams), drops faces that collapse and winds the
+        // faces outward: pressure pushes along the triangle normals, and XPBD's
+        // volume constraint compares the signed volume with a positive rest one.
+        static Mesh Weld(const std::vector<Vec3>& positions, const std::vector<uint32_t>& indices) {
+            std::vector<uint32_t> sorted(positions.size());
+            for (uint32_t i = 0; i < sorted.size(); i++) {
+                sorted[i] = i;
+            }
+            auto less = [&positions](uint32_t a, uint32_t b) {
+                const Vec3& p = positions[a];
+                const Vec3& q = positions[b];
+                return p.x < q.x || (p.x == q.x && (p.y < q.y || (p.y == q.y && p.z < q.z)));
+            };
+            std::sort(sorted.begin(), sorted.end(), less);
+
+            Mesh mesh;
+            std::vector<uint32_t> remap(positions.size());
+            for (size_t k = 0; k < sorted.size(); k++) {
+                if (k == 0 || less(sorted[k - 1], sorted[k])) {
+                    mesh.positions.push_back(positions[sorted[k]]);
+                }
+                remap[sorted[k]] = uint32_t(mesh.positions.size() - 1);
+            }
+            for (size_t f = 0; f + 2 < indices.size(); f += 3) {
+                uint32_t a = remap[indices[f]];
+                uint32_t b = remap[indices[f + 1]];
+                uint32_t c = remap[indices[f + 2]];
+                if (a != b && b != c && c != a) {
+                    mesh.triangles.push_back(glm::vec3(a, b, c));
+                }
+            }
+            if (SignedVolume(mesh) < T(0)) {
+                for (glm::vec3& triangle : mesh.triangles) {
+                    std::swap(triangle[1], triangle[2]);
+                }
+            }
+            return mesh;
+        }
+
+        // Volume enclosed by the surface, positive when the faces wind counter-clockwise seen from outside.
+        static T SignedVolume(const Mesh& mesh) {
+            if (mesh.positions.empty()) {
+                return T(0);
+            }
+            Vec3 p(T(0)); // any reference point works for a closed surface; the centroid keeps the terms small
+            for (const Vec3& position : mesh.positions) {
+                p += position;
+            }
+            p /= T(mesh.positions.size());
+            T volume = T(0);
+            for (glm::vec3 triangle : mesh.triangles) {
+                const Vec3& x1 = mesh.positions[uint32_t(triangle[0])];
+                const Vec3& x2 = mesh.positions[uint32_t(triangle[1])];
+                const Vec3& x3 = mesh.positions[uint32_t(triangle[2])];
+                volume += glm::dot(x1 - p, glm::cross(x2 - p, x3 - p)) / T(6);
+            }
+            return volume;
+        }
+
+        // Minimal OBJ reader for headless runs (the app uses gloo's MeshLoader): vertex
+        // positions and faces only, polygons fanned into triangles, then welded.
+        static Mesh ReadObj(const std::string& filename) {
+            std::ifstream file(filename);
+            if (!file) {
+                throw std::runtime_error("Cannot open mesh: " + filename + ".");
+            }
+            std::vector<Vec3> positions;
+            std::vector<uint32_t> indices;
+            std::string line;
+            while (std::getline(file, line)) {
+                std::istringstream tokens(line);
+                std::string kind;
+                tokens >> kind;
+                if (kind == "v") {
+                    Vec3 p(T(0));
+                    tokens >> p.x >> p.y >> p.z;
+                    positions.push_back(p);
+                }
+                else if (kind == "f") {
+                    std::vector<uint32_t> face;
+                    for (std::string corner; tokens >> corner;) {
+                        long index = std::stol(corner.substr(0, corner.find('/'))); // "v", "v/vt", "v//vn" or "v/vt/vn"
+                        face.push_back(uint32_t(index < 0 ? long(positions.size()) + index : index - 1));
+                    }
+                    for (size_t k = 2; k < face.size(); k++) {
+                        indices.push_back(face[0]);
+                        indices.push_back(face[k - 1]);
+                        indices.push_back(face[k]);
+                    }
+                }
+            }
+            for (uint32_t index : indices) {
+                if (index >= positions.size()) {
+                    throw std::runtime_error("Face index out of range in mesh: " + filename + ".");
+                }
+            }
+            return Weld(positions, indices);
+        }
+
+        // Centers the mesh on its vertex centroid and scales it to unit bounding radius.
+        static void Normalize(Mesh& mesh) {
+            if (mesh.positions.empty()) {
+                return;
+            }
+            Vec3 centroid(T(0));
+            for (const Vec3& p : mesh.positions) {
+                centroid += p;
+            }
+            centroid /= T(mesh.positions.size());
+            T radius = T(0);
+            for (Vec3& p : mesh.positions) {
+                p -= centroid;
+                radius = std::max(radius, glm::length(p));
+            }
+            if (radius > T(0)) {
+                for (Vec3& p : mesh.positions) {
+                    p /= radius;
+                }
+            }
+        }
+
+        // Places the (normalized) mesh around `center`, scaled so its bounding radius is `radius`.
+        static void Build(const Mesh& mesh, Vec3 center, T radius, std::vector<Vec3>& positions, std::vector<glm::vec3>& triangles) {
+            positions.clear();
+            positions.reserve(mesh.positions.size() + 1);
+            positions.push_back(center);
+            for (const Vec3& p : mesh.positions) {
+                positions.push_back(center + radius * p);
+            }
+            triangles.clear();
+            triangles.reserve(mesh.triangles.size());
+            for (glm::vec3 triangle : mesh.triangles) {
+                triangles.push_back(triangle + glm::vec3(1, 1, 1)); // the center takes index 0
+            }
+        }
+
+        template <class TSystem>
+        static void AddSprings(TSystem& system, const std::vector<Vec3>& positions, const std::vector<glm::vec3>& triangles,
+                               T surface_k, T bending_k, T interior_k, int interior_chords) {
+            // edge table: one (edge, opposite vertex) entry per half-edge, sorted by edge
+            std::vector<uint64_t> keys(3 * triangles.size());
+            std::vector<uint32_t> opposite(3 * triangles.size());
+            for (size_t t = 0; t < triangles.size(); t++) {
+                for (int c = 0; c < 3; c++) {
+                    uint32_t a = uint32_t(triangles[t][c]);
+                    uint32_t b = uint32_t(triangles[t][(c + 1) % 3]);
+                    keys[3 * t + c] = (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+                    opposite[3 * t + c] = uint32_t(triangles[t][(c + 2) % 3]);
+                }
+            }
+            RadixSort(keys, opposite, positions.size());
+
+            size_t structural = system.AddSpringGroup(SpringKind::Surface, surface_k, keys.size() / 2);
+            size_t bending = bending_k != T(0) ? system.AddSpringGroup(SpringKind::Bending, bending_k, keys.size() / 2) : 0;
+            for (size_t begin = 0, end = 0; begin < keys.size(); begin = end) {
+                while (end < keys.size() && keys[end] == keys[begin]) {
+                    end++;
+                }
+                uint32_t a = uint32_t(keys[begin] >> 32);
+                uint32_t b = uint32_t(keys[begin]);
+                system.AddSpring(structural, a, b, glm::length(positions[a] - positions[b]));
+
+                // a manifold edge has exactly two faces; boundary and non-manifold edges get no bending spring
+                uint32_t c = opposite[begin];
+                uint32_t d = opposite[begin + 1 < end ? begin + 1 : begin];
+                if (bending_k != T(0) && end - begin == 2 && c != d) {
+                    system.AddSpring(bending, c, d, glm::length(positions[c] - positions[d]));
+                }
+            }
+
+            if (interior_k == T(0)) {
+                return;
+            }
+
+            // spokes from the center hold the shape against collapse
+            size_t spokes = system.AddSpringGroup(SpringKind::Radial, interior_k, positions.size() - 1);
+            for (uint32_t i = 1; i < positions.size(); i++) {
+                system.AddSpring(spokes, 0, i, glm::length(positions[i] - positions[0]));
+            }
+
+            // chords: rank the vertices along a space-filling curve and tie each one to
+            // vertices half a curve (and further fractions) away, which lie across the body
+            if (interior_chords > 0 && positions.size() > 2) {
+                std::vector<uint32_t> curve = ordering::MortonOrder(positions, 1);
+                size_t n = curve.size() - 1;
+                std::vector<size_t> offsets;
+                for (int c = 0; c < interior_chords; c++) {
+                    offsets.push_back(n / 2 + c * n / (2 * size_t(interior_chords)));
+                }
+                std::sort(offsets.begin(), offsets.end());
+                offsets.erase(std::unique(offsets.begin(), offsets.end()), offsets.end());
+                size_t chords = system.AddSpringGroup(SpringKind::Chordal, interior_k, n * offsets.size());
+                for (size_t offset : offsets) {
+                    // offset o ties r to r + o, which offset n - o already tied back to r;
+                    // at o = n / 2 the pairs repeat halfway round the curve
+                    size_t complement = n - offset;
+                    if (offset == 0 || (complement < offset && std::binary_search(offsets.begin(), offsets.end(), complement))) {
+                        continue;
+                    }
+                    for (size_t r = 0, count = complement == offset ? n / 2 : n; r < count; r++) {
+                        uint32_t i = curve[1 + r];
+                        uint32_t j = curve[1 + (r + offset) % n];
+                        system.AddSpring(chords, i, j, glm::length(positions[i] - positions[j]));
+                    }
+                }
+            }
+        }
+
+    private:
+        // LSD radix sort of the keys (16-bit digits), carrying `values` along.
+        // Only the digits that can be non-zero for indices below `count` are sorted.
+        static void RadixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values, size_t count) {
+            int index_bits = 1;
+            while ((uint64_t(1) << index_bits) < count) {
+                index_bits++;
+            }
+            std::vector<uint64_t> key_buffer(keys.size());
+            std::vector<uint32_t> value_buffer(values.size());
+            std::vector<size_t> offsets(1 << 16);
+            for (int pass = 0; pass < 4; pass++) {
+                int shift = 16 * pass;
+                bool low_word = shift < 32;
+                if ((low_word ? shift : shift - 32) >= index_bits) {
+                    continue; // digit is zero for every key
+                }
+                std::fill(offsets.begin(), offsets.end(), 0);
+                for (uint64_t key : keys) {
+                    offsets[(key >> shift) & 0xffff]++;
+                }
+                size_t sum = 0;
+                for (size_t& offset : offsets) {
+                    size_t digit_count = offset;
+                    offset = sum;
+                    sum += digit_count;
+                }
+                for (size_t k = 0; k < keys.size(); k++) {
+                    size_t slot = offsets[(keys[k] >> shift) & 0xffff]++;
+                    key_buffer[slot] = keys[k];
+                    value_buffer[slot] = values[k];
+                }
+                keys.swap(key_buffer);
+                values.swap(value_buffer);
+            }
+        }
+    };
+}  // namespace GLOO
+
+#endif
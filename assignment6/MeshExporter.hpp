@@ -0,0 +1,233 @@
+#ifndef MESH_EXPORTER_H_
+#define MESH_EXPORTER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ThreadPool.hpp"
+
+
+namespace GLOO {
+    enum class MeshFormat { PLY, OBJ };
+
+    // Writes surface snapshots to disk as numbered files, one per body and
+    // frame ("<directory>/<name>_00042.ply"), for offline rendering. Submit
+    // only copies the positions; the triangles are shared between frames
+    // and encoding plus file I/O run on the exporter's own worker threads,
+    // never on the calling thread or the global pool that runs the solvers.
+    //
+    // Each body (by name) may have at most `max_pending_per_body` frames
+    // queued, so the queue grows with the number of bodies a scene submits
+    // per frame and one slow body cannot starve the others. When the encoder
+    // falls behind, Submit either drops the body's frame (interactive use,
+    // the simulation never waits) or blocks until one of its slots frees up
+    // (offline runs that need every frame). Dropped frames are counted per
+    // body. One exporter is meant to be shared by all balls of a scene.
+    class MeshExporter {
+    public:
+        using Triangles = std::shared_ptr<const std::vector<glm::vec3>>;
+
+        MeshExporter(const std::string& directory, MeshFormat format = MeshFormat::PLY, size_t max_pending_per_body = 16,
+                     size_t thread_count = 2)
+            : directory_(directory), format_(format), max_pending_per_body_(std::max<size_t>(max_pending_per_body, 1)),
+              pool_(std::max<size_t>(thread_count, 1) + 1) { // the pool's queue 0 is fed by this thread, not a worker
+        }
+
+        ~MeshExporter() {
+            Flush();
+        }
+
+        MeshExporter(const MeshExporter&) = delete;
+        MeshExporter& operator=(const MeshExporter&) = delete;
+
+        // Queues one frame of a body. Vertices that no triangle references (the
+        // center particle) are left out of the file. Returns false if the frame was
+        // dropped because the body's queue is full and `block` is off.
+        bool Submit(const std::string& name, int frame, const std::vector<glm::vec3>& positions, Triangles triangles,
+                    bool block = false) {
+            BodyQueue* body;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                body = &bodies_[name]; // map nodes stay put, so the worker can update it later
+                if (body->pending >= max_pending_per_body_) {
+                    if (!block) {
+                        body->dropped++;
+                        dropped_++;
+                        return false;
+                    }
+                    slot_freed_.wait(lock, [this, body] { return body->pending < max_pending_per_body_; });
+                }
+                body->pending++;
+                pending_++;
+            }
+
+            char suffix[32];
+            snprintf(suffix, sizeof(suffix), "_%05d.%s", frame, format_ == MeshFormat::PLY ? "ply" : "obj");
+            std::string path = (directory_.empty() ? std::string() : directory_ + "/") + name + suffix;
+            auto snapshot = std::make_shared<std::vector<glm::vec3>>(positions);
+            MeshFormat format = format_;
+            pool_.Submit(group_, [this, body, path, snapshot, triangles, format] {
+                bool ok = Write(path, format, *snapshot, *triangles);
+                std::lock_guard<std::mutex> lock(mutex_);
+                (ok ? written_ : failed_)++;
+                body->pending--;
+                pending_--;
+                slot_freed_.notify_all();
+            });
+            return true;
+        }
+
+        // Waits until every queued frame is on disk.
+        void Flush() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            slot_freed_.wait(lock, [this] { return pending_ == 0; });
+        }
+
+        void SetFormat(MeshFormat format) {
+            format_ = format;
+        }
+        MeshFormat GetFormat() const {
+            return format_;
+        }
+        const std::string& GetDirectory() const {
+            return directory_;
+        }
+        size_t GetPending() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return pending_;
+        }
+        size_t GetWritten() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return written_;
+        }
+        size_t GetDropped() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return dropped_;
+        }
+        size_t GetFailed() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return failed_;
+        }
+        // (name, dropped frames) of every body that lost at least one frame, by name
+        std::vector<std::pair<std::string, size_t>> GetDroppedByBody() const {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::vector<std::pair<std::string, size_t>> dropped;
+            for (const auto& body : bodies_) {
+                if (body.second.dropped > 0) {
+                    dropped.emplace_back(body.first, body.second.dropped);
+                }
+            }
+            return dropped;
+        }
+
+    private:
+        static bool Write(const std::string& path, MeshFormat format, const std::vector<glm::vec3>& positions,
+                          const std::vector<glm::vec3>& triangles) {
+            // compact to the referenced vertices
+            std::vector<uint32_t> remap(positions.size(), UINT32_MAX);
+            std::vector<uint32_t> used;
+            for (const glm::vec3& triangle : triangles) {
+                for (int c = 0; c < 3; c++) {
+                    uint32_t v = uint32_t(triangle[c]);
+                    if (remap[v] == UINT32_MAX) {
+                        remap[v] = uint32_t(used.size());
+                        used.push_back(v);
+                    }
+                }
+            }
+
+            std::string bytes = format == MeshFormat::PLY ? EncodePly(positions, triangles, remap, used)
+                                                          : EncodeObj(positions, triangles, remap, used);
+            // written under a temporary name so a renderer polling the directory never reads a partial file
+            std::string temporary = path + ".part";
+            FILE* file = fopen(temporary.c_str(), "wb");
+            if (file == nullptr) {
+                return false;
+            }
+            bool ok = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+            ok = fclose(file) == 0 && ok;
+            return ok && std::rename(temporary.c_str(), path.c_str()) == 0;
+        }
+
+        static void AppendLittleEndian(std::string& bytes, uint32_t value) {
+            for (int b = 0; b < 4; b++) {
+                bytes.push_back(char((value >> (8 * b)) & 0xff));
+            }
+        }
+
+        static std::string EncodePly(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& triangles,
+                                     const std::vector<uint32_t>& remap, const std::vector<uint32_t>& used) {
+            std::string bytes = "ply\nformat binary_little_endian 1.0\n";
+            bytes += "element vertex " + std::to_string(used.size()) + "\n";
+            bytes += "property float x\nproperty float y\nproperty float z\n";
+            bytes += "element face " + std::to_string(triangles.size()) + "\n";
+            bytes += "property list uchar int vertex_indices\nend_header\n";
+            bytes.reserve(bytes.size() + 12 * used.size() + 13 * triangles.size());
+            for (uint32_t v : used) {
+                for (int c = 0; c < 3; c++) {
+                    uint32_t bits;
+                    float value = positions[v][c];
+                    std::memcpy(&bits, &value, sizeof(bits));
+                    AppendLittleEndian(bytes, bits);
+                }
+            }
+            for (const glm::vec3& triangle : triangles) {
+                bytes.push_back(char(3));
+                for (int c = 0; c < 3; c++) {
+                    AppendLittleEndian(bytes, remap[uint32_t(triangle[c])]);
+                }
+            }
+            return bytes;
+        }
+
+        static std::string EncodeObj(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& triangles,
+                                     const std::vector<uint32_t>& remap, const std::vector<uint32_t>& used) {
+            std::string bytes;
+            bytes.reserve(40 * used.size() + 24 * triangles.size());
+            char line[96];
+            for (uint32_t v : used) {
+                int length = snprintf(line, sizeof(line), "v %.7g %.7g %.7g\n", positions[v].x, positions[v].y, positions[v].z);
+                bytes.append(line, size_t(length));
+            }
+            for (const glm::vec3& triangle : triangles) {
+                int length = snprintf(line, sizeof(line), "f %u %u %u\n", remap[uint32_t(triangle[0])] + 1,
+                                      remap[uint32_t(triangle[1])] + 1, remap[uint32_t(triangle[2])] + 1);
+                bytes.append(line, size_t(length));
+            }
+            return bytes;
+        }
+
+        struct BodyQueue {
+            size_t pending = 0;
+            size_t dropped = 0;
+        };
+
+        std::string directory_;
+        std::atomic<MeshFormat> format_;
+        size_t max_pending_per_body_;
+
+        mutable std::mutex mutex_;
+        std::condition_variable slot_freed_;
+        std::map<std::string, BodyQueue> bodies_;
+        size_t pending_ = 0; // over all bodies
+        size_t written_ = 0;
+        size_t dropped_ = 0;
+        size_t failed_ = 0;
+
+        ThreadPool::TaskGroup group_;
+        ThreadPool pool_; // declared last, so its workers are joined before anything they touch goes away
+    };
+}  // namespace GLOO
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef MULTI_RATE_INTEGRATOR_H_
+#define MULTI_RATE_INTEGRATOR_H_
+
+#include <vector>
+
+#include "IntegratorBase.hpp"
+#include "PendulumSystem.hpp"
+
+namespace GLOO {
+// Substepped velocity Verlet in an r-RESPA frame. The force terms in
+// `fast_terms` are advanced with velocity Verlet at dt / fast_substeps; the
+// rest are applied as half-kicks at each end of the coarse step dt.
+//
+// By default only gravity is slow, so this is plain 16x-substepped Verlet:
+// every spring kind (the O(n^2) chordal network included) and pressure are
+// evaluated on every fine step. Keeping the chords on the coarse rate needs
+// smaller steps than RK4, since the all-pairs network is the stiffest term
+// in aggregate, and pressure applied as coarse kicks resonates with the
+// spring modes of a ball resting on the ground. What the coarse step still
+// saves is the per-step work outside the integrator: the surface normals and
+// volume that pressure reads, and self-collision, are updated once per dt.
+// Verlet needs one force evaluation per fine step against RK4's four, so it
+// is cheaper per simulated second at the step sizes where both are stable.
+template <class TSystem, class TState>
+class MultiRateIntegrator : public IntegratorBase<TSystem, TState> {
+ public:
+  using Scalar = typename TState::Scalar;
+  using Vec3 = glm::vec<3, Scalar>;
+
+  explicit MultiRateIntegrator(int fast_substeps = 16,
+                               unsigned fast_terms = kAllForces & ~kGravityForce)
+      : fast_substeps_(fast_substeps), fast_terms_(fast_terms) {
+  }
+
+  void Integrate(const TSystem& system,
+                 TState& state,
+                 float start_time,
+                 float dt) const override {
+    const unsigned slow_terms = kAllForces & ~fast_terms_;
+    Scalar coarse = dt;
+    Scalar fine = coarse / Scalar(fast_substeps_);
+    const std::vector<Scalar>& w = system.GetInverseMasses();
+    TState& next = state; // advanced in place
+
+    // opening slow half-kick
+    system.ComputeAcceleration(next, slow_terms, slow_);
+    Kick(next, slow_, coarse / 2);
+
+    // fine velocity Verlet on the stiff terms; fixed particles stay put
+    system.ComputeAcceleration(next, fast_terms_, fast_);
+    for (int n = 0; n < fast_substeps_; n++) {
+      Kick(next, fast_, fine / 2);
+      for (size_t i = 0; i < next.positions.size(); i++) {
+        if (w[i] != Scalar(0)) {
+          next.positions[i] += fine * next.velocities[i];
+        }
+      }
+      system.ComputeAcceleration(next, fast_terms_, fast_);
+      Kick(next, fast_, fine / 2);
+    }
+
+    // closing slow half-kick
+    system.ComputeAcceleration(next, slow_terms, slow_);
+    Kick(next, slow_, coarse / 2);
+  }
+
+ private:
+  static void Kick(TState& state, const std::vector<Vec3>& accelerations, Scalar h) {
+    for (size_t i = 0; i < state.velocities.size(); i++) {
+      state.velocities[i] += h * accelerations[i];
+    }
+  }
+
+  int fast_substeps_;
+  unsigned fast_terms_;
+  mutable std::vector<Vec3> slow_; // scratch accelerations, reused across steps
+  mutable std::vector<Vec3> fast_;
+};
+}  // namespace GLOO
+
+#endif
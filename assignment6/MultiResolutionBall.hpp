@@ -0,0 +1,302 @@
+#ifndef MULTI_RESOLUTION_BALL_H_
+#define MULTI_RESOLUTION_BALL_H_
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include "BallSimulation.hpp"
+
+
+namespace GLOO {
+    // Level-of-detail policy. By distance, the ball runs at max_level up to
+    // near_distance from the camera and drops one level per doubling beyond it.
+    // By budget, the level steps down while a frame's simulation time exceeds
+    // frame_budget_ms and steps up while the next level's estimated cost fits.
+    struct LodSettings {
+        bool enabled = false;
+        bool by_budget = false;
+        int min_level = 1;
+        int max_level = 4;
+        float near_distance = 2.f;
+        float frame_budget_ms = 8.f;
+        float min_switch_interval = 0.5f; // s between level changes, so the policy cannot oscillate every frame
+    };
+
+    // A soft-body ball that can change subdivision level while it runs. Each level
+    // is a full BallSimulationT built on first use. Because the icosphere numbers its
+    // vertices coarse to fine, a coarse sphere's vertices are a prefix of every finer
+    // one: moving up a level prolongs the state by placing each new vertex from its
+    // two parents with the builder's own midpoint rule (velocities averaged), and
+    // moving down restricts it by injection onto the surviving vertices followed by
+    // a uniform velocity shift. Both directions keep the center-of-mass velocity.
+    //
+    // Every level models the same body: the vertex masses and the per-spring
+    // parameters are scaled from the constructed level so that total mass,
+    // pressure, drag and the springs' pull on the body stay the same, and a
+    // switch changes resolution, not dynamics (see LevelParams).
+    template <class T>
+    class MultiResolutionBallT {
+    public:
+        using Vec3 = glm::vec<3, T>;
+        using State = ParticleStateT<T>;
+        using Simulation = BallSimulationT<T>;
+        using System = typename Simulation::System;
+
+        // A non-empty `mesh` builds a mesh body instead, which has a single level.
+        explicit MultiResolutionBallT(const BallParams& params, Vec3 start_center = Vec3(T(0), T(1), T(0)),
+                                      const SurfaceMeshT<T>& mesh = SurfaceMeshT<T>())
+            : params_(params), start_center_(start_center), level_(params.subdivisions),
+              max_level_(params.subdivisions > kMaxLevel ? params.subdivisions : kMaxLevel),
+              icosphere_(mesh.positions.empty()) {
+            levels_.resize(max_level_ + 1);
+            if (icosphere_) {
+                levels_[level_].reset(new Simulation(LevelParams(level_), start_center_));
+            }
+            else {
+                levels_[level_].reset(new Simulation(params_, start_center_, mesh));
+            }
+        }
+
+        // Only single-layer icospheres nest; other bodies keep their construction level.
+        bool SupportsLevelChanges() const {
+            return icosphere_ && params_.surface_layers == 1;
+        }
+        int GetLevel() const {
+            return level_;
+        }
+        int GetBaseLevel() const {
+            return params_.subdivisions; // the level the ball was constructed at
+        }
+        int GetMaxLevel() const {
+            return max_level_;
+        }
+
+        void SetLevel(int level) {
+            level = std::min(std::max(level, 0), max_level_);
+            if (level == level_ || !SupportsLevelChanges()) {
+                return;
+            }
+            Simulation& from = Active();
+            if (!levels_[level]) {
+                levels_[level].reset(new Simulation(LevelParams(level), start_center_));
+            }
+            Simulation& to = *levels_[level];
+            if (parents_.size() < to.GetStartPositions().size()) {
+                // vertex hierarchy up to the new level, built on the first switch that reaches it;
+                // every coarser level's parents are a prefix of it
+                std::vector<Vec3> positions;
+                std::vector<glm::vec3> triangles;
+                IcosphereBuilder<T>(level, 1).Build(Vec3(T(0)), T(1), positions, triangles, &parents_);
+            }
+            to.SetGround(from.GetGround());
+            to.SetDiagnostics(from.GetDiagnostics());
+            to.SetState(Transfer(from, to), from.IsDropped(), from.IsAsleep(), from.GetTimeDebt());
+            to.SetStepStats(from.GetStepStats());
+            level_ = level;
+            since_switch_ = 0.0;
+        }
+
+        // Picks and applies a level from the policy. `distance` is the camera distance
+        // and `step_ms` the wall time the last frame's Step took.
+        void UpdateLevel(const LodSettings& settings, double delta_time, double distance, double step_ms) {
+            since_switch_ += delta_time;
+            if (!settings.enabled || since_switch_ < settings.min_switch_interval) {
+                return;
+            }
+            int lo = std::max(settings.min_level, 0);
+            int hi = std::min(settings.max_level, max_level_);
+            int level = level_;
+            if (settings.by_budget) {
+                if (Active().IsAsleep()) {
+                    return; // a sleeping ball costs nothing, so its timing says nothing
+                }
+                if (step_ms > settings.frame_budget_ms) {
+                    level--;
+                }
+                else if (step_ms * CostEstimate(level_ + 1) / CostEstimate(level_) < settings.frame_budget_ms) {
+                    level++;
+                }
+            }
+            else {
+                double doublings = std::log2(std::max(distance, double(settings.near_distance)) / settings.near_distance);
+                level = hi - int(doublings);
+            }
+            SetLevel(std::min(std::max(level, lo), hi));
+        }
+
+        // forwarded to the active level
+        void Reset(Vec3 start_center) {
+            start_center_ = start_center;
+            for (std::unique_ptr<Simulation>& simulation : levels_) {
+                if (simulation) {
+                    simulation->Reset(start_center);
+                }
+            }
+        }
+        void Restart() {
+            Active().Restart();
+        }
+        void Drop() {
+            Active().Drop();
+        }
+        void Step(double delta_time) {
+            Active().Step(delta_time);
+        }
+        void Wake() {
+            Active().Wake();
+        }
+        bool IsAsleep() const {
+            return Active().IsAsleep();
+        }
+        bool IsDropped() const {
+            return Active().IsDropped();
+        }
+        void SetMaxSubsteps(int max_substeps) {
+            params_.max_substeps = max_substeps;
+            for (std::unique_ptr<Simulation>& simulation : levels_) {
+                if (simulation) {
+                    simulation->SetMaxSubsteps(max_substeps);
+                }
+            }
+        }
+        void SetDiagnostics(DiagnosticsRecorder* diagnostics) {
+            for (std::unique_ptr<Simulation>& simulation : levels_) {
+                if (simulation) {
+                    simulation->SetDiagnostics(diagnostics);
+                }
+            }
+        }
+        ContactSphere GetContactSphere() const {
+            return Active().GetContactSphere();
+        }
+        size_t ResolveContacts(const std::vector<ContactSphere>& spheres, size_t self) {
+            return Active().ResolveContacts(spheres, self);
+        }
+        void SetGround(const GroundCollider& ground) {
+            for (std::unique_ptr<Simulation>& simulation : levels_) {
+                if (simulation) {
+                    simulation->SetGround(ground);
+                }
+            }
+        }
+
+        const State& GetState() const {
+            return Active().GetState();
+        }
+        const std::vector<Vec3>& GetStartPositions() const {
+            return Active().GetStartPositions();
+        }
+        const std::vector<glm::vec3>& GetTriangles() const {
+            return Active().GetTriangles();
+        }
+        const System& GetSystem() const {
+            return Active().GetSystem();
+        }
+        const BallParams& GetParams() const {
+            return Active().GetParams();
+        }
+        const typename Simulation::StepStats& GetStepStats() const {
+            return Active().GetStepStats();
+        }
+        Simulation& Active() {
+            return *levels_[level_];
+        }
+        const Simulation& Active() const {
+            return *levels_[level_];
+        }
+
+    private:
+        static const int kMaxLevel = 4;
+
+        BallParams LevelParams(int level) const {
+            // With n surface vertices, the vertex masses and the drag and radial spring per
+            // vertex scale with 1 / n and the all-pairs chords with 1 / (n (n - 1)), keeping
+            // their totals. Surface springs form a membrane whose tension does not depend
+            // on the edge length, and pressure is spread by area, so both stay as they are.
+            BallParams params = params_;
+            params.subdivisions = level;
+            double base = double(IcosphereBuilder<T>::ParticleCount(params_.subdivisions) - 1);
+            double n = double(IcosphereBuilder<T>::ParticleCount(level) - 1);
+            params.vertex_mass *= base / n;
+            params.b *= base / n;
+            params.radial_k *= base / n;
+            params.chordal_k *= base * (base - 1.0) / (n * (n - 1.0));
+            return params;
+        }
+
+        double CostEstimate(int level) const {
+            // spring count: the chordal network is all pairs, the surface three per triangle
+            double n = double(IcosphereBuilder<T>::ParticleCount(level) - 1);
+            double chordal = params_.chordal_k != 0.0 ? n * (n - 1.0) / 2.0 : 0.0;
+            return chordal + 3.0 * 20.0 * std::pow(4.0, level) + (params_.radial_k != 0.0 ? n : 0.0);
+        }
+
+        State Transfer(const Simulation& from, const Simulation& to) const {
+            const State& source = from.GetState();
+            const std::vector<uint32_t>& from_order = from.GetParticleOrder();
+            const std::vector<uint32_t>& to_order = to.GetParticleOrder();
+            size_t from_count = source.positions.size();
+            size_t to_count = to.GetStartPositions().size();
+
+            // back to construction numbering, where the levels nest
+            State nested;
+            nested.positions.resize(std::max(from_count, to_count));
+            nested.velocities.resize(std::max(from_count, to_count));
+            for (size_t k = 0; k < from_count; k++) {
+                nested.positions[from_order[k]] = source.positions[k];
+                nested.velocities[from_order[k]] = source.velocities[k];
+            }
+
+            // prolongation: parents always precede their midpoints
+            for (size_t i = from_count; i < to_count; i++) {
+                glm::uvec2 parents = parents_[i];
+                nested.positions[i] = IcosphereBuilder<T>::Midpoint(nested.positions[0], nested.positions[parents[0]],
+                                                                    nested.positions[parents[1]]);
+                nested.velocities[i] = (nested.velocities[parents[0]] + nested.velocities[parents[1]]) / T(2);
+            }
+
+            // restriction: injection onto the coarse prefix
+            nested.positions.resize(to_count);
+            nested.velocities.resize(to_count);
+            ordering::Permute(nested.positions, to_order);
+            ordering::Permute(nested.velocities, to_order);
+
+            // the levels carry different masses, so match center-of-mass velocities
+            Vec3 shift = CenterOfMassVelocity(from.GetSystem(), source) - CenterOfMassVelocity(to.GetSystem(), nested);
+            const std::vector<T>& inverse_masses = to.GetSystem().GetInverseMasses();
+            for (size_t i = 0; i < to_count; i++) {
+                if (inverse_masses[i] != T(0)) {
+                    nested.velocities[i] += shift;
+                }
+            }
+            return nested;
+        }
+
+        static Vec3 CenterOfMassVelocity(const System& system, const State& state) {
+            // summed in double: the shift must cancel to well below the velocities' float rounding
+            const std::vector<T>& masses = system.GetMasses();
+            glm::dvec3 momentum(0.0);
+            double total_mass = 0.0;
+            for (size_t i = 0; i < state.velocities.size(); i++) {
+                momentum += double(masses[i]) * glm::dvec3(state.velocities[i]);
+                total_mass += double(masses[i]);
+            }
+            return total_mass > 0.0 ? Vec3(momentum / total_mass) : Vec3(T(0));
+        }
+
+        BallParams params_;
+        Vec3 start_center_;
+        int level_;
+        int max_level_;
+        bool icosphere_;
+        std::vector<std::unique_ptr<Simulation>> levels_; // indexed by subdivision level, built on demand
+        std::vector<glm::uvec2> parents_; // construction-order midpoint parents of the finest level switched up to
+        double since_switch_ = 0.0;
+    };
+
+    using MultiResolutionBall = MultiResolutionBallT<float>;
+}  // namespace GLOO
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef PARTICLE_INSTANCES_NODE_H_
+#define PARTICLE_INSTANCES_NODE_H_
+
+#include "gloo/SceneNode.hpp"
+#include "gloo/components/MaterialComponent.hpp"
+#include "gloo/components/RenderingComponent.hpp"
+#include "gloo/components/ShadingComponent.hpp"
+#include "gloo/debug/PrimitiveFactory.hpp"
+#include "gloo/shaders/PhongShader.hpp"
+#include "ThreadPool.hpp"
+
+
+namespace GLOO {
+    // Draws one small sphere per particle as a single mesh. gloo's rendering
+    // component has no instanced draw call, so the instances are expanded on
+    // the CPU: the template sphere is copied once per instance position into
+    // one vertex buffer, drawn with one call. Indices and normals only change
+    // with the instance count; positions are uploaded once per SetInstances.
+    class ParticleInstancesNode : public SceneNode {
+    public:
+        ParticleInstancesNode(float radius, std::shared_ptr<Material> material, std::shared_ptr<ShaderProgram> shader)
+            : sphere_(PrimitiveFactory::CreateSphere(radius, 10, 10)) {
+            CreateComponent<MaterialComponent>(material);
+            CreateComponent<ShadingComponent>(shader);
+            CreateComponent<RenderingComponent>(mesh_);
+        }
+
+        void SetInstances(const std::vector<glm::vec3>& centers) {
+            const PositionArray& sphere_positions = sphere_->GetPositions();
+            size_t stride = sphere_positions.size();
+            if (centers.size() != instance_count_) {
+                Resize(centers.size());
+            }
+
+            auto positions = make_unique<PositionArray>(centers.size() * stride);
+            PositionArray& out = *positions;
+            ThreadPool::GetInstance().ParallelFor(centers.size(), kGrain, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    for (size_t v = 0; v < stride; v++) {
+                        out[i * stride + v] = sphere_positions[v] + centers[i];
+                    }
+                }
+            });
+            mesh_->UpdatePositions(std::move(positions));
+        }
+
+    private:
+        static const size_t kGrain = 256;
+
+        void Resize(size_t count) {
+            // indices and normals depend only on how many instances there are
+            const IndexArray& sphere_indices = sphere_->GetIndices();
+            const NormalArray& sphere_normals = sphere_->GetNormals();
+            auto indices = make_unique<IndexArray>();
+            auto normals = make_unique<NormalArray>();
+            indices->reserve(count * sphere_indices.size());
+            normals->reserve(count * sphere_normals.size());
+            for (size_t i = 0; i < count; i++) {
+                unsigned int offset = unsigned(i * sphere_->GetPositions().size());
+                for (unsigned int index : sphere_indices) {
+                    indices->push_back(index + offset);
+                }
+                normals->insert(normals->end(), sphere_normals.begin(), sphere_normals.end());
+            }
+            mesh_->UpdateIndices(std::move(indices));
+            mesh_->UpdateNormals(std::move(normals));
+            instance_count_ = count;
+        }
+
+        std::unique_ptr<VertexObject> sphere_; // template instance
+        std::shared_ptr<VertexObject> mesh_ = std::make_shared<VertexObject>();
+        size_t instance_count_ = 0;
+    };
+} // namespace GLOO
+
+#endif
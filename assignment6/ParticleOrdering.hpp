@@ -0,0 +1,177 @@
+#ifndef PARTICLE_ORDERING_H_
+#define PARTICLE_ORDERING_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <queue>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+
+namespace GLOO {
+    // Optional renumbering of particles after construction so that spring
+    // endpoints land close together in memory. Particles before `first` (the
+    // ball's center) keep their index; the rest are permuted.
+    enum class ParticleOrdering { None, Morton, ReverseCuthillMcKee };
+
+    namespace ordering {
+        inline uint32_t SpreadBits(uint32_t v) {
+            // spreads the low 10 bits of v so that two zero bits follow each one
+            v &= 0x3ff;
+            v = (v | (v << 16)) & 0x030000ff;
+            v = (v | (v << 8)) & 0x0300f00f;
+            v = (v | (v << 4)) & 0x030c30c3;
+            v = (v | (v << 2)) & 0x09249249;
+            return v;
+        }
+
+        template <class TVec3>
+        std::vector<uint32_t> MortonOrder(const std::vector<TVec3>& positions, uint32_t first) {
+            // returns new-to-old indices sorted along a Z-order curve over the bounding box
+            std::vector<uint32_t> order(positions.size());
+            for (uint32_t i = 0; i < order.size(); i++) {
+                order[i] = i;
+            }
+            if (positions.size() <= first + 1) {
+                return order;
+            }
+
+            TVec3 lo = positions[first];
+            TVec3 hi = positions[first];
+            for (size_t i = first; i < positions.size(); i++) {
+                lo = glm::min(lo, positions[i]);
+                hi = glm::max(hi, positions[i]);
+            }
+            std::vector<uint32_t> codes(positions.size(), 0);
+            for (size_t i = first; i < positions.size(); i++) {
+                uint32_t code = 0;
+                for (int axis = 0; axis < 3; axis++) {
+                    double extent = double(hi[axis] - lo[axis]);
+                    double t = extent > 0.0 ? double(positions[i][axis] - lo[axis]) / extent : 0.0;
+                    code |= SpreadBits(uint32_t(t * 1023.0)) << axis;
+                }
+                codes[i] = code;
+            }
+            std::stable_sort(order.begin() + first, order.end(), [&codes](uint32_t a, uint32_t b) {
+                return codes[a] < codes[b];
+            });
+            return order;
+        }
+
+        inline std::vector<uint32_t> ReverseCuthillMcKeeOrder(size_t count, const std::vector<glm::vec3>& triangles, uint32_t first) {
+            // returns new-to-old indices from a reverse Cuthill-McKee sweep of the surface edge graph
+            std::vector<std::vector<uint32_t>> neighbors(count);
+            for (glm::vec3 triangle : triangles) {
+                for (int e = 0; e < 3; e++) {
+                    uint32_t a = uint32_t(triangle[e]);
+                    uint32_t b = uint32_t(triangle[(e + 1) % 3]);
+                    neighbors[a].push_back(b);
+                    neighbors[b].push_back(a);
+                }
+            }
+            for (std::vector<uint32_t>& n : neighbors) {
+                std::sort(n.begin(), n.end());
+                n.erase(std::unique(n.begin(), n.end()), n.end());
+            }
+            auto by_degree = [&neighbors](uint32_t a, uint32_t b) {
+                return neighbors[a].size() < neighbors[b].size() || (neighbors[a].size() == neighbors[b].size() && a < b);
+            };
+
+            // visit components starting from their lowest-degree vertex
+            std::vector<uint32_t> seeds;
+            for (uint32_t i = first; i < count; i++) {
+                seeds.push_back(i);
+            }
+            std::sort(seeds.begin(), seeds.end(), by_degree);
+
+            std::vector<bool> visited(count, false);
+            std::vector<uint32_t> cm;
+            cm.reserve(count - first);
+            std::vector<uint32_t> adjacent;
+            for (uint32_t seed : seeds) {
+                if (visited[seed]) {
+                    continue;
+                }
+                std::queue<uint32_t> frontier;
+                frontier.push(seed);
+                visited[seed] = true;
+                while (!frontier.empty()) {
+                    uint32_t v = frontier.front();
+                    frontier.pop();
+                    cm.push_back(v);
+                    adjacent.clear();
+                    for (uint32_t w : neighbors[v]) {
+                        if (w >= first && !visited[w]) {
+                            visited[w] = true;
+                            adjacent.push_back(w);
+                        }
+                    }
+                    std::sort(adjacent.begin(), adjacent.end(), by_degree);
+                    for (uint32_t w : adjacent) {
+                        frontier.push(w);
+                    }
+                }
+            }
+
+            std::vector<uint32_t> order;
+            order.reserve(count);
+            for (uint32_t i = 0; i < first; i++) {
+                order.push_back(i);
+            }
+            order.insert(order.end(), cm.rbegin(), cm.rend());
+            return order;
+        }
+
+        template <class TVec3>
+        std::vector<uint32_t> ComputeOrder(ParticleOrdering ordering, const std::vector<TVec3>& positions,
+                                           const std::vector<glm::vec3>& triangles, uint32_t first) {
+            switch (ordering) {
+                case ParticleOrdering::Morton:
+                    return MortonOrder(positions, first);
+                case ParticleOrdering::ReverseCuthillMcKee:
+                    return ReverseCuthillMcKeeOrder(positions.size(), triangles, first);
+                default:
+                    break;
+            }
+            std::vector<uint32_t> order(positions.size());
+            for (uint32_t i = 0; i < order.size(); i++) {
+                order[i] = i;
+            }
+            return order;
+        }
+
+        template <class TValue>
+        void Permute(std::vector<TValue>& values, const std::vector<uint32_t>& order) {
+            // values[k] <- values[order[k]]
+            std::vector<TValue> permuted;
+            permuted.reserve(values.size());
+            for (uint32_t old_index : order) {
+                permuted.push_back(values[old_index]);
+            }
+            values.swap(permuted);
+        }
+
+        inline void RenumberTriangles(std::vector<glm::vec3>& triangles, const std::vector<uint32_t>& order) {
+            std::vector<uint32_t> old_to_new(order.size());
+            for (uint32_t k = 0; k < order.size(); k++) {
+                old_to_new[order[k]] = k;
+            }
+            for (glm::vec3& triangle : triangles) {
+                triangle = glm::vec3(old_to_new[uint32_t(triangle[0])],
+                                     old_to_new[uint32_t(triangle[1])],
+                                     old_to_new[uint32_t(triangle[2])]);
+            }
+
+            // visit triangles in order of their lowest vertex so surface passes sweep memory forward
+            auto lowest = [](const glm::vec3& t) {
+                return std::min(std::min(t[0], t[1]), t[2]);
+            };
+            std::stable_sort(triangles.begin(), triangles.end(), [&lowest](const glm::vec3& a, const glm::vec3& b) {
+                return lowest(a) < lowest(b);
+            });
+        }
+    }  // namespace ordering
+}  // namespace GLOO
+
+#endif
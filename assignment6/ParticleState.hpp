@@ -7,12 +7,17 @@
 #include <glm/glm.hpp>
 
 namespace GLOO {
-struct ParticleState {
-  // The state of a particle system: positions and velocities.
-  std::vector<glm::vec3> positions;
-  std::vector<glm::vec3> velocities;
+template <class T>
+struct ParticleStateT {
+  // The state of a particle system: positions and velocities, stored at
+  // scalar precision T (float for production, double for accuracy studies).
+  using Scalar = T;
+  using Vec3 = glm::vec<3, T>;
 
-  ParticleState& operator+=(const ParticleState& rhs) {
+  std::vector<Vec3> positions;
+  std::vector<Vec3> velocities;
+
+  ParticleStateT& operator+=(const ParticleStateT& rhs) {
     if (positions.size() != rhs.positions.size() ||
         velocities.size() != rhs.velocities.size() ||
         positions.size() != rhs.velocities.size()) {
@@ -27,29 +32,63 @@ struct ParticleState {
     return *this;
   }
 
-  ParticleState& operator*=(float k) {
+  ParticleStateT& operator*=(T k) {
     for (size_t i = 0; i < positions.size(); i++) {
       positions[i] *= k;
       velocities[i] *= k;
     }
     return *this;
   }
+
+  // In-place forms of the operators below, for integrators that keep their
+  // intermediate states in reused buffers instead of temporaries.
+  // *this += k * rhs
+  void AddScaled(T k, const ParticleStateT& rhs) {
+    if (positions.size() != rhs.positions.size() ||
+        velocities.size() != rhs.velocities.size()) {
+      throw std::runtime_error(
+          "Cannot add particle states with inconsistent sizes!");
+    }
+    for (size_t i = 0; i < positions.size(); i++) {
+      positions[i] += k * rhs.positions[i];
+      velocities[i] += k * rhs.velocities[i];
+    }
+  }
+  // *this = base + k * rhs, reusing this state's storage
+  void AssignScaledSum(const ParticleStateT& base, T k, const ParticleStateT& rhs) {
+    positions.assign(base.positions.begin(), base.positions.end());
+    velocities.assign(base.velocities.begin(), base.velocities.end());
+    AddScaled(k, rhs);
+  }
 };
 
-// Operators, optimized via overloading + std::move.
-inline ParticleState operator+(ParticleState s1, const ParticleState& s2) {
+using ParticleState = ParticleStateT<float>;
+using ParticleStateD = ParticleStateT<double>;
+
+// Operators, optimized via overloading + std::move. The scalar factor is taken
+// as ParticleStateT<T>::Scalar (a non-deduced context) so that float step
+// sizes and integer weights convert implicitly for double states.
+template <class T>
+inline ParticleStateT<T> operator+(ParticleStateT<T> s1,
+                                   const ParticleStateT<T>& s2) {
   s1 += s2;
   return s1;
 }
-inline ParticleState operator+(const ParticleState& s1, ParticleState&& s2) {
+template <class T>
+inline ParticleStateT<T> operator+(const ParticleStateT<T>& s1,
+                                   ParticleStateT<T>&& s2) {
   s2 += s1;
   return std::move(s2);
 }
-inline ParticleState operator*(ParticleState s1, float k) {
+template <class T>
+inline ParticleStateT<T> operator*(ParticleStateT<T> s1,
+                                   typename ParticleStateT<T>::Scalar k) {
   s1 *= k;
   return s1;
 }
-inline ParticleState operator*(float k, ParticleState s1) {
+template <class T>
+inline ParticleStateT<T> operator*(typename ParticleStateT<T>::Scalar k,
+                                   ParticleStateT<T> s1) {
   s1 *= k;
   return s1;
 }
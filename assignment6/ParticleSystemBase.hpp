@@ -4,14 +4,22 @@
 #include "ParticleState.hpp"
 
 namespace GLOO {
-class ParticleSystemBase {
+template <class T>
+class ParticleSystemBaseT {
  public:
-  virtual ~ParticleSystemBase() {
+  using Scalar = T;
+  using State = ParticleStateT<T>;
+
+  virtual ~ParticleSystemBaseT() {
   }
 
-  virtual ParticleState ComputeTimeDerivative(const ParticleState& state,
-                                              float time) const = 0;
+  // Writes d(state)/dt into `derivative`, reusing its storage.
+  virtual void ComputeTimeDerivative(const State& state,
+                                     float time,
+                                     State& derivative) const = 0;
 };
+
+using ParticleSystemBase = ParticleSystemBaseT<float>;
 }  // namespace GLOO
 
 #endif
@@ -1,101 +1,641 @@
 #ifndef PENDULUM_SYSTEM_H_
 #define PENDULUM_SYSTEM_H_
 
+#include "AllocationTracker.hpp"
+#include "GroundCollider.hpp"
 #include "ParticleSystemBase.hpp"
+#include "SpringGroup.hpp"
+#include "ThreadPool.hpp"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
 #include <glm/gtx/string_cast.hpp>
 
 
 namespace GLOO {
-    class PendulumSystem : public ParticleSystemBase {
+    // Force terms of PendulumSystemT that can be evaluated on their own, e.g.
+    // at different rates by MultiRateIntegrator.
+    enum ForceTerm : unsigned {
+        kGravityForce = 1u << 0,
+        kDragForce = 1u << 1,
+        kPressureForce = 1u << 2,
+        kRadialSpringForce = 1u << 3,
+        kChordalSpringForce = 1u << 4,
+        kSurfaceSpringForce = 1u << 5,
+        kBendingSpringForce = 1u << 6,
+        kAllForces = (1u << 7) - 1,
+    };
+
+    inline unsigned SpringForceTerm(SpringKind kind) {
+        return kRadialSpringForce << unsigned(kind);
+    }
+
+    // How the force and surface passes run on more than one thread.
+    //   Fast           chunks scatter into whichever accumulation buffer is free,
+    //                  so the order in which a particle's contributions are added
+    //                  (and with it the rounding) depends on scheduling.
+    //   Deterministic  fixed partitioning: per-spring forces and per-triangle
+    //                  normals are computed in parallel into arrays, then each
+    //                  particle gathers its own terms in spring/triangle order and
+    //                  the volume is summed in triangle order. Every particle sees
+    //                  the same sequence of additions as the serial loops, so the
+    //                  results are bit-identical to a single thread for any
+    //                  thread count.
+    // With a single-threaded pool both modes run the serial loops.
+    enum class ExecutionMode { Fast, Deterministic };
+
+    template <class T>
+    class PendulumSystemT : public ParticleSystemBaseT<T> {
     public:
-        ParticleState ComputeTimeDerivative(const ParticleState& state, float time) const override {
-            std::vector<glm::vec3> positions;
-            std::vector<glm::vec3> velocities;
+        using Scalar = T;
+        using Vec3 = glm::vec<3, T>;
+        using State = ParticleStateT<T>;
+        using SpringGroup = SpringGroupT<T>;
 
+        void ComputeTimeDerivative(const State& state, float time, State& derivative) const override {
+            GLOO_ALLOCATION_PHASE("PendulumSystem::ComputeTimeDerivative");
+            derivative.positions.resize(state.positions.size());
             for (size_t i = 0; i < state.positions.size(); i++) {
-                if (fixed_[i]) {
-                    positions.push_back(glm::vec3(0.f));
-                    velocities.push_back(glm::vec3(0.f));
-                }
-                else {
-                    positions.push_back(state.velocities[i]);
-                    float m = masses_[i];
-                    glm::vec3 drag_force = -b_ * state.velocities[i];
-                    glm::vec3 pressure_force = normals_[i]/2.f * nRT_ / volume_; // PV = nRT --> F = A*P = A*nRT/V
-                    velocities.push_back(g_ + (drag_force + pressure_force)/m); // 1/m * (mg + -kx')
-                }
+                derivative.positions[i] = fixed_[i] ? Vec3(T(0)) : state.velocities[i];
             }
+            ComputeAcceleration(state, kAllForces, derivative.velocities);
+        }
 
-            for (size_t s = 0; s < springs_.size(); s++) {
-                int i = springs_[s][0];
-                int j = springs_[s][1];
+        void ComputeAcceleration(const State& state, unsigned terms, std::vector<Vec3>& accelerations) const {
+            // accelerations from the selected ForceTerm bits only (fixed particles get zero)
+            const size_t n = state.positions.size();
+            accelerations.assign(n, Vec3(T(0)));
+            if (terms & (kGravityForce | kDragForce | kPressureForce)) {
+                ThreadPool::GetInstance().ParallelFor(n, kParticleGrain, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end; i++) {
+                        if (fixed_[i]) {
+                            continue;
+                        }
+                        Vec3 force(T(0));
+                        if (terms & kDragForce) {
+                            force += -b_ * state.velocities[i];
+                        }
+                        if (terms & kPressureForce) {
+                            force += normals_[i] / T(2) * nRT_ / volume_; // PV = nRT --> F = A*P = A*nRT/V
+                        }
+                        accelerations[i] = force / masses_[i]; // 1/m * (mg + -kx')
+                        if (terms & kGravityForce) {
+                            accelerations[i] += g_;
+                        }
+                    }
+                });
+            }
 
-                float m_i = masses_[i];
-                float r_ij = springs_[s][2];
-                float k_ij = springs_[s][3];
-                glm::vec3 d_i = state.positions[i] - state.positions[j];
-                glm::vec3 spring_force_i = (1 / m_i) * -k_ij * (glm::length(d_i) - r_ij) * (d_i / glm::length(d_i)); // 1/m * (force sum over connected particles)
-                if (!fixed_[i]) {
-                    velocities[i] += spring_force_i;
+            if (ThreadPool::GetInstance().GetThreadCount() == 1) {
+                for (const SpringGroup& group : spring_groups_) {
+                    if (terms & SpringForceTerm(group.kind)) {
+                        AccumulateSprings(group, state.positions, 0, group.size(), accelerations);
+                    }
                 }
-
-                float m_j = masses_[j];
-                glm::vec3 d_j = state.positions[j] - state.positions[i];
-                glm::vec3 spring_force_j = (1 / m_j) * -k_ij * (glm::length(d_j) - r_ij) * (d_j / glm::length(d_j)); // 1/m * (force sum over connected particles)
-                if (!fixed_[j]) {
-                    velocities[j] += spring_force_j;
+            }
+            else if (mode_ == ExecutionMode::Deterministic) {
+                GatherSprings(state.positions, terms, accelerations);
+            }
+            else {
+                for (const SpringGroup& group : spring_groups_) {
+                    if (!(terms & SpringForceTerm(group.kind))) {
+                        continue;
+                    }
+                    ThreadPool::GetInstance().ParallelFor(group.size(), kSpringGrain, [&](size_t begin, size_t end) {
+                        Buffer* buffer = ClaimBuffer(n);
+                        AccumulateSprings(group, state.positions, begin, end, buffer->values);
+                        ReleaseBuffer(buffer);
+                    });
                 }
+                FoldBuffers(accelerations, nullptr);
             }
-            
-            return { positions, velocities };
         }
 
-        void AddMass(float m, bool is_fixed) {
+        void SetExecutionMode(ExecutionMode mode) {
+            mode_ = mode;
+            ReserveBuffers();
+        }
+
+        ExecutionMode GetExecutionMode() const {
+            return mode_;
+        }
+
+        void AddMass(T m, bool is_fixed) {
             // adds particle of mass m (fixes particle if is_fixed=true)
             masses_.push_back(m);
             fixed_.push_back(is_fixed);
+            inv_masses_.push_back(is_fixed ? T(0) : T(1) / m);
+        }
+
+        size_t AddSpringGroup(SpringKind kind, T k, size_t expected_size = 0) {
+            // adds an empty group of springs sharing stiffness k; returns its id for AddSpring
+            spring_groups_.push_back(SpringGroup{ kind, k, {}, {}, {} });
+            spring_groups_.back().reserve(expected_size);
+            incidence_valid_ = false;
+            return spring_groups_.size() - 1;
+        }
+
+        SpringGroup& AddSpringGroupOfSize(SpringKind kind, T k, size_t count) {
+            // adds a group of `count` springs for the caller to fill in place (e.g. from several threads);
+            // the reference is valid until the next group is added
+            spring_groups_.push_back(SpringGroup{ kind, k, {}, {}, {} });
+            spring_groups_.back().resize(count);
+            incidence_valid_ = false;
+            return spring_groups_.back();
         }
 
-        void AddSpring(int i, int j, float r, float k) {
-            // adds spring of rest length r and stiffness k between particles i and j
-            springs_.push_back(glm::vec4(i, j, r, k));
+        void AddSpring(size_t group, uint32_t i, uint32_t j, T r) {
+            // adds spring of rest length r between particles i and j to a group (radial springs must have i = center)
+            spring_groups_[group].push_back(i, j, r);
+            incidence_valid_ = false;
         }
 
         void FixMass(int i, bool is_fixed) {
             fixed_[i] = is_fixed;
+            inv_masses_[i] = is_fixed ? T(0) : T(1) / masses_[i];
+        }
+
+        glm::vec<2, T> GetMass(int i) {
+            return glm::vec<2, T>(masses_[i], fixed_[i]);
+        }
+
+        const std::vector<SpringGroup>& GetSpringGroups() const {
+            return spring_groups_;
         }
 
-        glm::vec2 GetMass(int i) {
-            return glm::vec2(masses_[i], fixed_[i]);
+        void SortSprings() {
+            // orders each group by endpoint so kernels walk particles front to back
+            for (SpringGroup& group : spring_groups_) {
+                if (IsSorted(group)) {
+                    continue; // generated in order (e.g. the icosphere's chords): skip the O(n log n) pass
+                }
+                if (group.kind != SpringKind::Radial) { // radial springs must keep the center as their first endpoint
+                    for (size_t s = 0; s < group.size(); s++) {
+                        if (group.first[s] > group.second[s]) {
+                            std::swap(group.first[s], group.second[s]);
+                        }
+                    }
+                }
+                std::vector<uint32_t> order(group.size());
+                for (uint32_t s = 0; s < order.size(); s++) {
+                    order[s] = s;
+                }
+                std::sort(order.begin(), order.end(), [&group](uint32_t a, uint32_t b) {
+                    return group.first[a] < group.first[b] || (group.first[a] == group.first[b] && group.second[a] < group.second[b]);
+                });
+                SpringGroup sorted{ group.kind, group.k, {}, {}, {} };
+                sorted.reserve(group.size());
+                for (uint32_t s : order) {
+                    sorted.push_back(group.first[s], group.second[s], group.rest_lengths[s]);
+                }
+                group = std::move(sorted);
+            }
+            incidence_valid_ = false;
+            ReserveBuffers();
         }
 
-        glm::vec4 GetSpring(int i) {
-            return springs_[i];
+        size_t GetSpringCount() const {
+            size_t count = 0;
+            for (const SpringGroup& group : spring_groups_) {
+                count += group.size();
+            }
+            return count;
         }
 
         void SetTriangles(std::vector<glm::vec3> triangles) {
             triangles_ = triangles;
+            triangle_normals_.resize(triangles_.size());
+            triangle_volumes_.resize(triangles_.size());
+            std::vector<uint32_t> first, second;
+            for (uint32_t t = 0; t < triangles_.size(); t++) {
+                for (int c = 0; c < 3; c++) {
+                    first.push_back(uint32_t(triangles_[t][c]));
+                    second.push_back(t);
+                }
+            }
+            BuildRows(first, second, masses_.size(), triangle_rows_);
         }
 
-        void SetNormals(std::vector<glm::vec3> normals) {
+        void SetNormals(std::vector<Vec3> normals) {
             normals_ = normals;
         }
 
-        void SetVolume(float volume) {
+        void SetVolume(T volume) {
             volume_ = volume;
         }
 
+        void UpdateSurface(const std::vector<Vec3>& positions) {
+            // recompute area-weighted vertex normals and enclosed volume from the triangles set by SetTriangles
+            normals_.assign(positions.size(), Vec3(T(0)));
+            const Vec3 p = positions[0]; // anchor point to calculate volume of each tetrahedron
+            ThreadPool& pool = ThreadPool::GetInstance();
+            if (pool.GetThreadCount() == 1) {
+                T volume = T(0);
+                for (glm::vec3 triangle : triangles_) {
+                    int idx1 = triangle[0];
+                    int idx2 = triangle[1];
+                    int idx3 = triangle[2];
+                    Vec3 normal = glm::cross(positions[idx2] - positions[idx1], positions[idx3] - positions[idx1]);
+                    normals_[idx1] += normal;
+                    normals_[idx2] += normal;
+                    normals_[idx3] += normal;
+
+                    // signed volume of tetrahedron with vertex "p" and opposite face "triangle"
+                    volume += glm::dot(positions[idx1] - p, glm::cross(positions[idx2] - p, positions[idx3] - p)) / T(6);
+                }
+                volume_ = std::abs(volume);
+            }
+            else if (mode_ == ExecutionMode::Deterministic) {
+                pool.ParallelFor(triangles_.size(), kTriangleGrain, [&](size_t begin, size_t end) {
+                    for (size_t t = begin; t < end; t++) {
+                        const Vec3& x1 = positions[int(triangles_[t][0])];
+                        const Vec3& x2 = positions[int(triangles_[t][1])];
+                        const Vec3& x3 = positions[int(triangles_[t][2])];
+                        triangle_normals_[t] = glm::cross(x2 - x1, x3 - x1);
+                        triangle_volumes_[t] = glm::dot(x1 - p, glm::cross(x2 - p, x3 - p)) / T(6);
+                    }
+                });
+                pool.ParallelFor(positions.size(), kParticleGrain, [&](size_t begin, size_t end) {
+                    for (size_t i = begin; i < end && i + 1 < triangle_rows_.offsets.size(); i++) {
+                        for (uint32_t e = triangle_rows_.offsets[i]; e < triangle_rows_.offsets[i + 1]; e++) {
+                            normals_[i] += triangle_normals_[triangle_rows_.entries[e]];
+                        }
+                    }
+                });
+                T volume = T(0);
+                for (T tetrahedron : triangle_volumes_) { // ordered: a handful of adds per triangle is not worth splitting
+                    volume += tetrahedron;
+                }
+                volume_ = std::abs(volume);
+            }
+            else {
+                pool.ParallelFor(triangles_.size(), kTriangleGrain, [&](size_t begin, size_t end) {
+                    Buffer* buffer = ClaimBuffer(positions.size());
+                    std::vector<Vec3>& normals = buffer->values;
+                    T volume = T(0);
+                    for (size_t t = begin; t < end; t++) {
+                        int idx1 = triangles_[t][0];
+                        int idx2 = triangles_[t][1];
+                        int idx3 = triangles_[t][2];
+                        Vec3 normal = glm::cross(positions[idx2] - positions[idx1], positions[idx3] - positions[idx1]);
+                        normals[idx1] += normal;
+                        normals[idx2] += normal;
+                        normals[idx3] += normal;
+                        volume += glm::dot(positions[idx1] - p, glm::cross(positions[idx2] - p, positions[idx3] - p)) / T(6);
+                    }
+                    buffer->sum += volume;
+                    ReleaseBuffer(buffer);
+                });
+                T volume = T(0);
+                FoldBuffers(normals_, &volume);
+                volume_ = std::abs(volume);
+            }
+        }
+
+        const std::vector<Vec3>& GetNormals() const {
+            return normals_;
+        }
+
+        T GetVolume() const {
+            return volume_;
+        }
+
+        void SetRestVolume(T rest_volume) {
+            // volume the body returns to without load, for solvers that constrain it (0: unknown)
+            rest_volume_ = rest_volume;
+        }
+
+        T GetRestVolume() const {
+            return rest_volume_;
+        }
+
+        size_t GetParticleCount() const {
+            return masses_.size();
+        }
+
+        const std::vector<T>& GetMasses() const {
+            return masses_;
+        }
+
+        const std::vector<T>& GetInverseMasses() const {
+            return inv_masses_;
+        }
+
+        const std::vector<glm::vec3>& GetTriangles() const {
+            return triangles_;
+        }
+
+        Vec3 GetGravity() const {
+            return g_;
+        }
+
+        void SetGround(const GroundCollider& ground) {
+            ground_ = ground;
+        }
+
+        const GroundCollider& GetGround() const {
+            return ground_;
+        }
+
+        void ResolveGround(State& state) const {
+            // ground contact response of every particle (see GroundCollider::Resolve)
+            for (size_t i = 0; i < state.positions.size(); i++) {
+                ground_.Resolve(state.positions[i], state.velocities[i], kGroundEps);
+            }
+        }
+
+        void SetDrag(T b) {
+            b_ = b;
+        }
+
+        void SetPressureConstant(T nRT) {
+            nRT_ = nRT;
+        }
+
+        T GetDrag() const {
+            return b_;
+        }
+
+        T GetPressureConstant() const {
+            return nRT_;
+        }
+
     private:
-        std::vector<glm::vec4> springs_;
+        static const size_t kParticleGrain = 1024;
+        static const size_t kSpringGrain = 2048;
+        static constexpr float kGroundEps = 0.01f; // depth at which a particle counts as in contact
+        static const size_t kTriangleGrain = 2048;
+
+        // compressed rows: the entries of row i are offsets[i] .. offsets[i + 1]
+        struct Rows {
+            std::vector<uint32_t> offsets;
+            std::vector<uint32_t> entries;
+        };
+
+        // per-thread accumulation buffer of the fast parallel mode
+        struct Buffer {
+            std::vector<Vec3> values;
+            T sum = T(0);
+            bool touched = false;
+        };
+
+        static void BuildRows(const std::vector<uint32_t>& rows, const std::vector<uint32_t>& entries, size_t row_count, Rows& out) {
+            // counting sort that keeps the entries of each row in their given order
+            out.offsets.assign(row_count + 1, 0);
+            for (uint32_t row : rows) {
+                out.offsets[row + 1]++;
+            }
+            for (size_t i = 0; i < row_count; i++) {
+                out.offsets[i + 1] += out.offsets[i];
+            }
+            std::vector<uint32_t> cursor(out.offsets.begin(), out.offsets.end() - 1);
+            out.entries.resize(entries.size());
+            for (size_t e = 0; e < entries.size(); e++) {
+                out.entries[cursor[rows[e]]++] = entries[e];
+            }
+        }
+
+        static bool IsSorted(const SpringGroup& group) {
+            for (size_t s = 0; s < group.size(); s++) {
+                if (group.kind != SpringKind::Radial && group.first[s] > group.second[s]) {
+                    return false;
+                }
+                if (s > 0 && (group.first[s - 1] > group.first[s] ||
+                              (group.first[s - 1] == group.first[s] && group.second[s - 1] >= group.second[s]))) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void BuildIncidence() const {
+            // per group and particle, the incident springs in spring order: (s << 1) | (particle is the second endpoint)
+            incidence_.resize(spring_groups_.size());
+            spring_forces_.resize(spring_groups_.size());
+            for (size_t g = 0; g < spring_groups_.size(); g++) {
+                const SpringGroup& group = spring_groups_[g];
+                std::vector<uint32_t> particles, entries;
+                for (uint32_t s = 0; s < group.size(); s++) {
+                    if (group.kind != SpringKind::Radial) { // the center's reaction is summed separately
+                        particles.push_back(group.first[s]);
+                        entries.push_back(s << 1);
+                    }
+                    particles.push_back(group.second[s]);
+                    entries.push_back((s << 1) | 1);
+                }
+                BuildRows(particles, entries, masses_.size(), incidence_[g]);
+                spring_forces_[g].resize(group.size());
+            }
+            incidence_valid_ = true;
+        }
+
+        void GatherSprings(const std::vector<Vec3>& x, unsigned terms, std::vector<Vec3>& a) const {
+            if (!incidence_valid_) {
+                BuildIncidence();
+            }
+            ThreadPool& pool = ThreadPool::GetInstance();
+            std::vector<Vec3>& center_forces = center_forces_;
+            center_forces.assign(spring_groups_.size(), Vec3(T(0)));
+            for (size_t g = 0; g < spring_groups_.size(); g++) {
+                const SpringGroup& group = spring_groups_[g];
+                if (!(terms & SpringForceTerm(group.kind))) {
+                    continue;
+                }
+                std::vector<Vec3>& f = spring_forces_[g];
+                const T k = group.k;
+                pool.ParallelFor(group.size(), kSpringGrain, [&](size_t begin, size_t end) {
+                    for (size_t s = begin; s < end; s++) {
+                        Vec3 d = x[group.first[s]] - x[group.second[s]];
+                        T l = glm::length(d);
+                        f[s] = (-k * (l - group.rest_lengths[s]) / l) * d; // as in AccumulateSprings
+                    }
+                });
+                if (group.kind == SpringKind::Radial) {
+                    for (const Vec3& force : f) { // in spring order, like the serial kernel
+                        center_forces[g] += force;
+                    }
+                }
+            }
+
+            // each particle adds its terms group by group in spring order, as the serial kernels do
+            pool.ParallelFor(x.size(), kParticleGrain, [&](size_t begin, size_t end) {
+                for (size_t g = 0; g < spring_groups_.size(); g++) {
+                    const SpringGroup& group = spring_groups_[g];
+                    if (!(terms & SpringForceTerm(group.kind))) {
+                        continue;
+                    }
+                    const Rows& rows = incidence_[g];
+                    const std::vector<Vec3>& f = spring_forces_[g];
+                    for (size_t i = begin; i < end; i++) {
+                        for (uint32_t e = rows.offsets[i]; e < rows.offsets[i + 1]; e++) {
+                            uint32_t entry = rows.entries[e];
+                            if (entry & 1) {
+                                a[i] -= f[entry >> 1] * inv_masses_[i];
+                            }
+                            else {
+                                a[i] += f[entry >> 1] * inv_masses_[i];
+                            }
+                        }
+                        if (group.kind == SpringKind::Radial && group.size() > 0 && i == group.first[0]) {
+                            a[i] += center_forces[g] * inv_masses_[i];
+                        }
+                    }
+                }
+            });
+        }
+
+        void ReserveBuffers() {
+            // one buffer per pool thread, sized to the particles, so the fast mode never allocates while stepping
+            if (mode_ != ExecutionMode::Fast) {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(buffer_mutex_);
+            while (buffers_.size() < ThreadPool::GetInstance().GetThreadCount()) {
+                buffers_.emplace_back(new Buffer());
+                free_buffers_.push_back(buffers_.back().get());
+            }
+            for (const std::unique_ptr<Buffer>& buffer : buffers_) {
+                buffer->values.assign(masses_.size(), Vec3(T(0)));
+            }
+            touched_buffers_.reserve(buffers_.size());
+        }
+
+        Buffer* ClaimBuffer(size_t size) const {
+            // ReserveBuffers made one per pool thread; more only if outside threads step this system at once
+            Buffer* buffer;
+            {
+                std::lock_guard<std::mutex> lock(buffer_mutex_);
+                if (free_buffers_.empty()) {
+                    buffers_.emplace_back(new Buffer());
+                    free_buffers_.push_back(buffers_.back().get());
+                }
+                buffer = free_buffers_.back();
+                free_buffers_.pop_back();
+            }
+            if (buffer->values.size() != size) {
+                buffer->values.assign(size, Vec3(T(0)));
+            }
+            buffer->touched = true;
+            return buffer;
+        }
+
+        void ReleaseBuffer(Buffer* buffer) const {
+            std::lock_guard<std::mutex> lock(buffer_mutex_);
+            free_buffers_.push_back(buffer);
+        }
+
+        void FoldBuffers(std::vector<Vec3>& out, T* sum) const {
+            // adds the touched buffers into `out` (and their sums into `sum`), leaving them zeroed
+            std::vector<Buffer*>& touched = touched_buffers_;
+            touched.clear();
+            for (const std::unique_ptr<Buffer>& buffer : buffers_) {
+                if (buffer->touched) {
+                    touched.push_back(buffer.get());
+                    if (sum != nullptr) {
+                        *sum += buffer->sum;
+                    }
+                    buffer->sum = T(0);
+                    buffer->touched = false;
+                }
+            }
+            ThreadPool::GetInstance().ParallelFor(out.size(), kParticleGrain, [&](size_t begin, size_t end) {
+                for (Buffer* buffer : touched) {
+                    for (size_t i = begin; i < end; i++) {
+                        out[i] += buffer->values[i];
+                        buffer->values[i] = Vec3(T(0));
+                    }
+                }
+            });
+        }
+
+        void AccumulateSprings(const SpringGroup& group, const std::vector<Vec3>& x, size_t begin, size_t end, std::vector<Vec3>& a) const {
+            switch (group.kind) {
+                case SpringKind::Radial:
+                    AccumulateSprings<SpringKind::Radial>(group, x, begin, end, a);
+                    break;
+                case SpringKind::Chordal:
+                    AccumulateSprings<SpringKind::Chordal>(group, x, begin, end, a);
+                    break;
+                case SpringKind::Surface:
+                    AccumulateSprings<SpringKind::Surface>(group, x, begin, end, a);
+                    break;
+                case SpringKind::Bending:
+                    AccumulateSprings<SpringKind::Bending>(group, x, begin, end, a);
+                    break;
+            }
+        }
+
+        template <SpringKind kKind>
+        void AccumulateSprings(const SpringGroup& group, const std::vector<Vec3>& x, size_t begin, size_t end, std::vector<Vec3>& a) const {
+            // springs [begin, end) of the group; stiffness is loaded once, and fixed particles have zero inverse mass so no branch is needed
+            const T k = group.k;
+            const uint32_t* first = group.first.data();
+            const uint32_t* second = group.second.data();
+            const T* rest = group.rest_lengths.data();
+            const T* inv_m = inv_masses_.data();
+
+            if (kKind == SpringKind::Radial) {
+                // every radial spring starts at the same center particle, so its reaction is summed in a register
+                if (begin == end) {
+                    return;
+                }
+                const uint32_t c = first[begin];
+                const Vec3 x_c = x[c];
+                Vec3 center_force(T(0));
+                for (size_t s = begin; s < end; s++) {
+                    const uint32_t j = second[s];
+                    Vec3 d = x_c - x[j];
+                    T l = glm::length(d);
+                    Vec3 f = (-k * (l - rest[s]) / l) * d; // force on the center; j receives the opposite
+                    center_force += f;
+                    a[j] -= f * inv_m[j];
+                }
+                a[c] += center_force * inv_m[c];
+            }
+            else {
+                for (size_t s = begin; s < end; s++) {
+                    const uint32_t i = first[s];
+                    const uint32_t j = second[s];
+                    Vec3 d = x[i] - x[j];
+                    T l = glm::length(d);
+                    Vec3 f = (-k * (l - rest[s]) / l) * d; // force on i; j receives the opposite
+                    a[i] += f * inv_m[i]; // 1/m * (force sum over connected particles)
+                    a[j] -= f * inv_m[j];
+                }
+            }
+        }
+
+        std::vector<SpringGroup> spring_groups_;
         std::vector<bool> fixed_; // for each index i, true if particle i is fixed, else false
-        std::vector<float> masses_; // for each index i, contains particle i's mass
+        std::vector<T> masses_; // for each index i, contains particle i's mass
+        std::vector<T> inv_masses_; // for each index i, 1/m (0 if particle i is fixed)
         std::vector<glm::vec3> triangles_;
-        std::vector<glm::vec3> normals_;
-        float volume_;
-        const glm::vec3 g_ = glm::vec3(0.f, -9.8f, 0.f);
-        const float b_ = 0.0001f; // drag constant
-        const float nRT_ = 2.0f; // pressure constant
+        std::vector<Vec3> normals_;
+        T volume_;
+        T rest_volume_ = T(0);
+        const Vec3 g_ = Vec3(0.f, -9.8f, 0.f);
+        T b_ = T(0.0001); // drag constant
+        T nRT_ = T(2.0); // pressure constant
+        GroundCollider ground_;
+
+        // parallel execution
+        ExecutionMode mode_ = ExecutionMode::Fast;
+        Rows triangle_rows_; // per particle, its triangles in triangle order
+        std::vector<Vec3> triangle_normals_;
+        std::vector<T> triangle_volumes_;
+        mutable bool incidence_valid_ = false;
+        mutable std::vector<Rows> incidence_; // per spring group
+        mutable std::vector<std::vector<Vec3>> spring_forces_; // per spring group, force on the first endpoint
+        mutable std::vector<Vec3> center_forces_; // per spring group, scratch of GatherSprings
+        mutable std::mutex buffer_mutex_;
+        mutable std::vector<std::unique_ptr<Buffer>> buffers_;
+        mutable std::vector<Buffer*> free_buffers_;
+        mutable std::vector<Buffer*> touched_buffers_; // scratch of FoldBuffers
     };
+
+    using PendulumSystem = PendulumSystemT<float>;
+    using PendulumSystemD = PendulumSystemT<double>;
 }  // namespace GLOO
 
-#endif
\ No newline at end of file
+#endif
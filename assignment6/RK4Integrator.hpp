@@ -7,17 +7,33 @@
 namespace GLOO {
 template <class TSystem, class TState>
 class RK4Integrator : public IntegratorBase<TSystem, TState> {
-  TState Integrate(const TSystem& system,
-                   const TState& state,
-                   float start_time,
-                   float dt) const override {
-    ParticleState k_1 = system.ComputeTimeDerivative(state, start_time);
-    ParticleState k_2 = system.ComputeTimeDerivative(state+dt/2*k_1, start_time+dt/2);
-    ParticleState k_3 = system.ComputeTimeDerivative(state+dt/2*k_2, start_time+dt/2);
-    ParticleState k_4 = system.ComputeTimeDerivative(state+dt*k_3, start_time+dt);
-    TState new_state = state + dt/6 * (k_1 + 2*k_2 + 2*k_3 + k_4);
-    return new_state;
+  void Integrate(const TSystem& system,
+                 TState& state,
+                 float start_time,
+                 float dt) const override {
+    typename TState::Scalar h = dt; // step in the state's precision
+    system.ComputeTimeDerivative(state, start_time, k_1_);
+    stage_.AssignScaledSum(state, h/2, k_1_);
+    system.ComputeTimeDerivative(stage_, start_time+dt/2, k_2_);
+    stage_.AssignScaledSum(state, h/2, k_2_);
+    system.ComputeTimeDerivative(stage_, start_time+dt/2, k_3_);
+    stage_.AssignScaledSum(state, h, k_3_);
+    system.ComputeTimeDerivative(stage_, start_time+dt, k_4_);
+
+    // k_1 + 2*k_2 + 2*k_3 + k_4, summed in the same order as before
+    k_1_.AddScaled(2, k_2_);
+    k_1_.AddScaled(2, k_3_);
+    k_1_ += k_4_;
+    k_1_ *= h/6;
+    state += k_1_;
   }
+
+  // stage derivatives and the state they are evaluated at, reused across steps
+  mutable TState k_1_;
+  mutable TState k_2_;
+  mutable TState k_3_;
+  mutable TState k_4_;
+  mutable TState stage_;
 };
 }  // namespace GLOO
 
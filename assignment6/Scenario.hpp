@@ -0,0 +1,389 @@
+#ifndef SCENARIO_H_
+#define SCENARIO_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BallParams.hpp"
+#include "GroundCollider.hpp"
+
+
+namespace GLOO {
+    // One body of a scenario: its parameters and where it starts.
+    struct ScenarioBody {
+        BallParams params;
+        glm::vec3 start_center = glm::vec3(0.f, 1.f, 0.f);
+        bool dropped = true; // falling from the start; otherwise held until dropped
+    };
+
+    // A scene to simulate: bodies, the ground they collide with and how long
+    // to run (headless runs; the app runs until closed).
+    //
+    // Text form, one entry per line ('#' starts a comment):
+    //   duration 2.0                  simulated seconds
+    //   frame_rate 60                 rate at which headless runs step and sample
+    //   ground 0 -5 5 -5 5            height [left right back front]
+    //   <ball param> <value>          default for the balls that follow, e.g.
+    //                                 integrator r, step_size 0.0002
+    //   ball 0 1 0 [name=value ...]   a body at (x, y, z); any ball param and
+    //                                 dropped=0|1 may be overridden per ball
+    //
+    // Relative mesh paths are relative to the directory of the scenario file.
+    //
+    // The binary form (see scenario::SaveBinary) is a header followed by
+    // fixed-size body records and a string table, read with one fread and
+    // copied out without any parsing. Like an object file it is meant for the
+    // build and machine that compiled it: the header records the layout and
+    // loading rejects a mismatch.
+    struct Scenario {
+        double duration = 2.0;
+        double frame_rate = 60.0;
+        GroundCollider ground;
+        std::vector<ScenarioBody> bodies;
+    };
+
+    namespace scenario {
+        const char kMagic[8] = { 'B', 'A', 'L', 'L', 'S', 'C', 'N', '\0' };
+        const uint32_t kVersion = 1;
+
+        inline Scenario Parse(std::istream& in) {
+            Scenario scenario;
+            BallParams defaults;
+            std::string line;
+            for (int number = 1; std::getline(in, line); number++) {
+                line = line.substr(0, line.find('#'));
+                std::istringstream tokens(line);
+                std::string name;
+                if (!(tokens >> name)) {
+                    continue;
+                }
+                std::vector<std::string> values;
+                for (std::string value; tokens >> value;) {
+                    values.push_back(value);
+                }
+                auto fail = [&](const std::string& message) {
+                    return std::runtime_error("Scenario line " + std::to_string(number) + ": " + message);
+                };
+
+                auto expect = [&](bool ok, const char* usage) {
+                    if (!ok) {
+                        throw fail(std::string("expected ") + usage + ".");
+                    }
+                };
+
+                // std::stod and friends throw without saying where; every conversion goes through these
+                auto to_number = [&](const std::string& value) {
+                    try {
+                        size_t used = 0;
+                        double result = std::stod(value, &used);
+                        if (used == value.size()) {
+                            return result;
+                        }
+                    }
+                    catch (const std::logic_error&) {
+                    }
+                    throw fail("invalid number " + value + " for " + name + ".");
+                };
+                auto set = [&](BallParams& params, const std::string& key, const std::string& value) {
+                    try {
+                        return SetBallParam(params, key, value);
+                    }
+                    catch (const std::logic_error&) {
+                        throw fail("invalid value " + value + " for " + key + ".");
+                    }
+                    catch (const std::runtime_error& e) {
+                        throw fail(e.what());
+                    }
+                };
+
+                if (name == "duration") {
+                    expect(values.size() == 1, "duration <seconds>");
+                    scenario.duration = to_number(values[0]);
+                }
+                else if (name == "frame_rate") {
+                    expect(values.size() == 1, "frame_rate <hz>");
+                    scenario.frame_rate = to_number(values[0]);
+                }
+                else if (name == "ground") {
+                    expect(values.size() == 1 || values.size() == 5, "ground <height> [<left> <right> <back> <front>]");
+                    scenario.ground.height = float(to_number(values[0]));
+                    if (values.size() == 5) {
+                        scenario.ground.left_edge = float(to_number(values[1]));
+                        scenario.ground.right_edge = float(to_number(values[2]));
+                        scenario.ground.back_edge = float(to_number(values[3]));
+                        scenario.ground.front_edge = float(to_number(values[4]));
+                    }
+                }
+                else if (name == "ball") {
+                    expect(values.size() >= 3, "ball <x> <y> <z> [name=value ...]");
+                    ScenarioBody body;
+                    body.params = defaults;
+                    body.start_center = glm::vec3(float(to_number(values[0])), float(to_number(values[1])),
+                                                  float(to_number(values[2])));
+                    for (size_t v = 3; v < values.size(); v++) {
+                        size_t equals = values[v].find('=');
+                        expect(equals != std::string::npos, "name=value after the ball position");
+                        std::string key = values[v].substr(0, equals);
+                        std::string value = values[v].substr(equals + 1);
+                        if (key == "dropped") {
+                            body.dropped = to_number(value) != 0.0;
+                        }
+                        else if (!set(body.params, key, value)) {
+                            throw fail("unrecognized ball parameter " + key + ".");
+                        }
+                    }
+                    scenario.bodies.push_back(body);
+                }
+                else if (values.size() != 1) {
+                    throw fail("expected " + name + " <value>.");
+                }
+                else if (!set(defaults, name, values[0])) {
+                    throw fail("unrecognized entry " + name + ".");
+                }
+            }
+            return scenario;
+        }
+
+        // Fixed-layout images of the scenario, copied straight to and from disk.
+        struct FileHeader {
+            char magic[8];
+            uint32_t version;
+            uint32_t header_size; // layout check
+            uint32_t body_size;
+            uint32_t body_count;
+            uint32_t string_bytes;
+            double duration;
+            double frame_rate;
+            GroundCollider ground;
+        };
+
+        struct BodyRecord {
+            double scale;
+            int32_t subdivisions;
+            int32_t surface_layers;
+            double center_mass;
+            double vertex_mass;
+            uint8_t center_fixed;
+            uint8_t vertex_fixed;
+            uint8_t self_collision;
+            uint8_t deterministic;
+            uint8_t dropped;
+            uint8_t ordering;
+            uint8_t integrator;
+            double surface_k;
+            double chordal_k;
+            double radial_k;
+            uint32_t mesh_offset; // into the string table
+            uint32_t mesh_length;
+            double bending_k;
+            double interior_k;
+            int32_t interior_chords;
+            int32_t max_substeps;
+            double b;
+            double nRT;
+            double self_collision_thickness;
+            double step_size;
+            double sleep_kinetic_energy;
+            double sleep_speed;
+            double sleep_window;
+            float start_center[3];
+        };
+
+        static_assert(std::is_trivially_copyable<FileHeader>::value && std::is_trivially_copyable<BodyRecord>::value,
+                      "scenario records are copied as raw bytes");
+
+        inline BodyRecord ToRecord(const ScenarioBody& body, std::string& strings) {
+            const BallParams& p = body.params;
+            BodyRecord r;
+            std::memset(&r, 0, sizeof(r)); // padding too, so equal scenarios compile to equal files
+            r.scale = p.scale;
+            r.subdivisions = p.subdivisions;
+            r.surface_layers = p.surface_layers;
+            r.center_mass = p.center_mass;
+            r.vertex_mass = p.vertex_mass;
+            r.center_fixed = p.center_fixed;
+            r.vertex_fixed = p.vertex_fixed;
+            r.self_collision = p.self_collision;
+            r.deterministic = p.deterministic;
+            r.dropped = body.dropped;
+            r.ordering = uint8_t(p.ordering);
+            r.integrator = uint8_t(p.integrator);
+            r.surface_k = p.surface_k;
+            r.chordal_k = p.chordal_k;
+            r.radial_k = p.radial_k;
+            r.mesh_offset = uint32_t(strings.size());
+            r.mesh_length = uint32_t(p.mesh.size());
+            strings += p.mesh;
+            r.bending_k = p.bending_k;
+            r.interior_k = p.interior_k;
+            r.interior_chords = p.interior_chords;
+            r.max_substeps = p.max_substeps;
+            r.b = p.b;
+            r.nRT = p.nRT;
+            r.self_collision_thickness = p.self_collision_thickness;
+            r.step_size = p.step_size;
+            r.sleep_kinetic_energy = p.sleep_kinetic_energy;
+            r.sleep_speed = p.sleep_speed;
+            r.sleep_window = p.sleep_window;
+            for (int c = 0; c < 3; c++) {
+                r.start_center[c] = body.start_center[c];
+            }
+            return r;
+        }
+
+        inline ScenarioBody FromRecord(const BodyRecord& r, const char* strings) {
+            ScenarioBody body;
+            BallParams& p = body.params;
+            p.scale = r.scale;
+            p.subdivisions = r.subdivisions;
+            p.surface_layers = r.surface_layers;
+            p.center_mass = r.center_mass;
+            p.vertex_mass = r.vertex_mass;
+            p.center_fixed = r.center_fixed != 0;
+            p.vertex_fixed = r.vertex_fixed != 0;
+            p.self_collision = r.self_collision != 0;
+            p.deterministic = r.deterministic != 0;
+            body.dropped = r.dropped != 0;
+            if (r.ordering > uint8_t(ParticleOrdering::ReverseCuthillMcKee)) {
+                throw std::runtime_error("Compiled scenario is corrupt: unknown particle ordering " + std::to_string(r.ordering) + ".");
+            }
+            if (r.integrator > uint8_t(IntegratorType::MultiRate)) {
+                throw std::runtime_error("Compiled scenario is corrupt: unknown integrator " + std::to_string(r.integrator) + ".");
+            }
+            p.ordering = ParticleOrdering(r.ordering);
+            p.integrator = IntegratorType(r.integrator);
+            p.surface_k = r.surface_k;
+            p.chordal_k = r.chordal_k;
+            p.radial_k = r.radial_k;
+            p.mesh.assign(strings + r.mesh_offset, r.mesh_length);
+            p.bending_k = r.bending_k;
+            p.interior_k = r.interior_k;
+            p.interior_chords = r.interior_chords;
+            p.max_substeps = r.max_substeps;
+            p.b = r.b;
+            p.nRT = r.nRT;
+            p.self_collision_thickness = r.self_collision_thickness;
+            p.step_size = r.step_size;
+            p.sleep_kinetic_energy = r.sleep_kinetic_energy;
+            p.sleep_speed = r.sleep_speed;
+            p.sleep_window = r.sleep_window;
+            body.start_center = glm::vec3(r.start_center[0], r.start_center[1], r.start_center[2]);
+            return body;
+        }
+
+        inline void SaveBinary(const Scenario& scenario, const std::string& filename) {
+            std::string strings;
+            std::vector<BodyRecord> records;
+            records.reserve(scenario.bodies.size());
+            for (const ScenarioBody& body : scenario.bodies) {
+                records.push_back(ToRecord(body, strings));
+            }
+            FileHeader header;
+            std::memset(static_cast<void*>(&header), 0, sizeof(header));
+            std::memcpy(header.magic, kMagic, sizeof(kMagic));
+            header.version = kVersion;
+            header.header_size = sizeof(FileHeader);
+            header.body_size = sizeof(BodyRecord);
+            header.body_count = uint32_t(records.size());
+            header.string_bytes = uint32_t(strings.size());
+            header.duration = scenario.duration;
+            header.frame_rate = scenario.frame_rate;
+            header.ground = scenario.ground;
+
+            std::ofstream file(filename, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(records.data()), std::streamsize(records.size() * sizeof(BodyRecord)));
+            file.write(strings.data(), std::streamsize(strings.size()));
+            if (!file) {
+                throw std::runtime_error("Cannot write scenario: " + filename + ".");
+            }
+        }
+
+        // Reads a compiled scenario from memory; returns false if `bytes` is not one.
+        inline bool FromBinary(const std::vector<char>& bytes, Scenario& scenario) {
+            FileHeader header;
+            if (bytes.size() < sizeof(header)) {
+                return false;
+            }
+            std::memcpy(&header, bytes.data(), sizeof(header));
+            if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0) {
+                return false;
+            }
+            size_t expected = sizeof(header) + size_t(header.body_count) * sizeof(BodyRecord) + header.string_bytes;
+            if (header.version != kVersion || header.header_size != sizeof(FileHeader) ||
+                header.body_size != sizeof(BodyRecord) || bytes.size() != expected) {
+                throw std::runtime_error("Compiled scenario is from another version or build; recompile it.");
+            }
+            std::vector<BodyRecord> records(header.body_count);
+            std::memcpy(records.data(), bytes.data() + sizeof(header), records.size() * sizeof(BodyRecord));
+            const char* strings = bytes.data() + sizeof(header) + records.size() * sizeof(BodyRecord);
+
+            scenario.duration = header.duration;
+            scenario.frame_rate = header.frame_rate;
+            scenario.ground = header.ground;
+            scenario.bodies.clear();
+            scenario.bodies.reserve(records.size());
+            for (const BodyRecord& record : records) {
+                if (size_t(record.mesh_offset) + record.mesh_length > header.string_bytes) {
+                    throw std::runtime_error("Compiled scenario is corrupt.");
+                }
+                scenario.bodies.push_back(FromRecord(record, strings));
+            }
+            return true;
+        }
+
+        // Prefixes relative mesh paths with the directory of `filename`.
+        inline void ResolveMeshPaths(Scenario& scenario, const std::string& filename) {
+            size_t slash = filename.find_last_of('/');
+            if (slash == std::string::npos) {
+                return; // already relative to the working directory
+            }
+            std::string directory = filename.substr(0, slash + 1);
+            for (ScenarioBody& body : scenario.bodies) {
+                if (!body.params.mesh.empty() && body.params.mesh[0] != '/') {
+                    body.params.mesh = directory + body.params.mesh;
+                }
+            }
+        }
+
+        // Loads either form, telling them apart by the binary magic. Mesh paths are
+        // resolved against the file's directory unless `resolve_paths` is off (when
+        // compiling, so the binary keeps the paths as written and works beside its source).
+        inline Scenario Load(const std::string& filename, bool resolve_paths = true) {
+            FILE* file = fopen(filename.c_str(), "rb");
+            if (file == nullptr) {
+                throw std::runtime_error("Cannot open scenario: " + filename + ".");
+            }
+            std::vector<char> bytes;
+            if (fseek(file, 0, SEEK_END) == 0) {
+                long size = ftell(file);
+                bytes.resize(size > 0 ? size_t(size) : 0);
+                fseek(file, 0, SEEK_SET);
+            }
+            size_t read = fread(bytes.data(), 1, bytes.size(), file);
+            fclose(file);
+            bytes.resize(read);
+
+            Scenario scenario;
+            if (!FromBinary(bytes, scenario)) {
+                std::istringstream text(std::string(bytes.begin(), bytes.end()));
+                scenario = Parse(text);
+            }
+            if (resolve_paths) {
+                ResolveMeshPaths(scenario, filename);
+            }
+            return scenario;
+        }
+    }  // namespace scenario
+}  // namespace GLOO
+
+#endif
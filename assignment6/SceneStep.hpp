@@ -0,0 +1,119 @@
+#ifndef SCENE_STEP_H_
+#define SCENE_STEP_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "BodyContact.hpp"
+#include "Scenario.hpp"
+
+
+namespace GLOO {
+    // The step of a scene with several bodies, shared by every driver
+    // (scenario_runner, the ShardCoordinator workers, SimulationApp). Bodies
+    // advance in exchange rounds of `interval`, the smallest body step size;
+    // after each round every body's contact sphere (see BodyContact.hpp) is
+    // gathered and each body resolves its contacts against all of them, in
+    // body order. A round's contact spheres only depend on the bodies, so a
+    // sharded run, where `exchange` trades them between processes, steps
+    // exactly like an in-process one.
+    //
+    // TBody is anything with Step, GetContactSphere and ResolveContacts
+    // (BallSimulationT, MultiResolutionBallT).
+    class SceneStep {
+    public:
+        // Exchange alone needs no interval.
+        explicit SceneStep(double interval = 0.0) : interval_(interval) {
+        }
+
+        // the smallest body step size, so no body takes more than one step per round
+        static double ExchangeInterval(const Scenario& scenario) {
+            double interval = scenario.bodies.empty() ? 0.0 : scenario.bodies[0].params.step_size;
+            for (const ScenarioBody& body : scenario.bodies) {
+                interval = std::min(interval, body.params.step_size);
+            }
+            return interval;
+        }
+        // frames a headless run of the scenario records
+        static int FrameCount(const Scenario& scenario) {
+            return std::max(0, int(std::ceil(scenario.duration * scenario.frame_rate - 1e-9)));
+        }
+
+        double GetInterval() const {
+            return interval_;
+        }
+        int64_t GetRound() const {
+            return round_;
+        }
+
+        // Exchange rounds from the start through the end of `frame`, the same in every process.
+        int64_t RoundsThrough(int frame, double frame_rate) const {
+            return int64_t(std::floor((frame + 1) / frame_rate / interval_ + 1e-6));
+        }
+
+        // Runs the rounds up to the end of `frame` for `bodies`, the scene's bodies
+        // at `indices`. `exchange(spheres)` is called once per round, after these
+        // bodies' spheres were written at their indices, and must fill in the rest.
+        template <class TBody, class TExchange>
+        void AdvanceThrough(int frame, double frame_rate, const std::vector<TBody*>& bodies, const std::vector<size_t>& indices,
+                            std::vector<ContactSphere>& spheres, TExchange exchange) {
+            for (int64_t end = RoundsThrough(frame, frame_rate); round_ < end; round_++) {
+                for (size_t k = 0; k < bodies.size(); k++) {
+                    bodies[k]->Step(interval_);
+                    spheres[indices[k]] = bodies[k]->GetContactSphere();
+                }
+                exchange(spheres);
+                Resolve(bodies, indices, spheres);
+            }
+        }
+
+        // In-process form: `bodies` is the whole scene.
+        template <class TBody>
+        void AdvanceThrough(int frame, double frame_rate, const std::vector<TBody*>& bodies) {
+            Identity(bodies.size());
+            AdvanceThrough(frame, frame_rate, bodies, indices_, spheres_, [](std::vector<ContactSphere>&) {});
+        }
+
+        // Contact exchange alone, for bodies that were stepped elsewhere (the app's
+        // ball nodes step themselves by the frame time).
+        template <class TBody>
+        void Exchange(const std::vector<TBody*>& bodies) {
+            Identity(bodies.size());
+            for (size_t b = 0; b < bodies.size(); b++) {
+                spheres_[b] = bodies[b]->GetContactSphere();
+            }
+            Resolve(bodies, indices_, spheres_);
+        }
+
+    private:
+        template <class TBody>
+        static void Resolve(const std::vector<TBody*>& bodies, const std::vector<size_t>& indices,
+                            const std::vector<ContactSphere>& spheres) {
+            if (spheres.size() < 2) {
+                return; // nothing to collide with
+            }
+            for (size_t k = 0; k < bodies.size(); k++) {
+                bodies[k]->ResolveContacts(spheres, indices[k]);
+            }
+        }
+
+        void Identity(size_t count) {
+            if (indices_.size() != count) {
+                indices_.resize(count);
+                for (size_t b = 0; b < count; b++) {
+                    indices_[b] = b;
+                }
+                spheres_.resize(count);
+            }
+        }
+
+        double interval_;
+        int64_t round_ = 0; // rounds taken so far
+        std::vector<size_t> indices_; // 0 .. n-1, for the in-process forms
+        std::vector<ContactSphere> spheres_;
+    };
+}  // namespace GLOO
+
+#endif
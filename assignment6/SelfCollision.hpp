@@ -0,0 +1,293 @@
+#ifndef SELF_COLLISION_H_
+#define SELF_COLLISION_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ParticleState.hpp"
+#include "ThreadPool.hpp"
+
+
+namespace GLOO {
+    // Keeps surface particles from passing through the body's own triangles.
+    // Every step, triangle bounding boxes (grown by the contact thickness) are
+    // binned into a spatial hash with a counting sort (see BuildHash for what
+    // runs in parallel); each surface particle then tests only the triangles
+    // in its own cell, so the cost is linear in the surface size. Triangles touching the particle or its one-ring are
+    // skipped, since those are always within the thickness of it.
+    //
+    // A particle whose side of a triangle changed during the step, or that
+    // ended closer than the thickness, is pushed back out to the thickness on
+    // the side it came from and loses its approaching normal velocity. The
+    // query phase only reads positions, so particles run in parallel; the
+    // corrections are applied afterwards.
+    template <class T>
+    class SelfCollisionT {
+    public:
+        using Vec3 = glm::vec<3, T>;
+        using State = ParticleStateT<T>;
+
+        // `thickness` is given as a fraction of the mean surface edge length.
+        void Prepare(const std::vector<glm::vec3>& triangles, const std::vector<Vec3>& rest_positions, T thickness = T(0.25)) {
+            size_t count = rest_positions.size();
+            triangles_.resize(3 * triangles.size());
+            for (size_t t = 0; t < triangles.size(); t++) {
+                for (int c = 0; c < 3; c++) {
+                    triangles_[3 * t + c] = uint32_t(triangles[t][c]);
+                }
+            }
+
+            // one-ring neighbours in compressed rows, and the mean edge length
+            std::vector<std::vector<uint32_t>> neighbors(count);
+            T edge_sum = T(0);
+            for (size_t t = 0; t < triangles.size(); t++) {
+                for (int c = 0; c < 3; c++) {
+                    uint32_t a = triangles_[3 * t + c];
+                    uint32_t b = triangles_[3 * t + (c + 1) % 3];
+                    neighbors[a].push_back(b);
+                    neighbors[b].push_back(a);
+                    edge_sum += glm::length(rest_positions[a] - rest_positions[b]);
+                }
+            }
+            ring_offsets_.assign(1, 0);
+            ring_.clear();
+            surface_.clear();
+            for (uint32_t i = 0; i < count; i++) {
+                std::vector<uint32_t>& n = neighbors[i];
+                std::sort(n.begin(), n.end());
+                n.erase(std::unique(n.begin(), n.end()), n.end());
+                ring_.insert(ring_.end(), n.begin(), n.end());
+                ring_offsets_.push_back(uint32_t(ring_.size()));
+                if (!n.empty()) {
+                    surface_.push_back(i);
+                }
+            }
+
+            T mean_edge = triangles.empty() ? T(0) : edge_sum / T(3 * triangles.size());
+            thickness_ = thickness * mean_edge;
+            cell_size_ = std::max(mean_edge, T(2) * thickness_);
+            table_size_ = 1;
+            while (table_size_ < 2 * triangles.size()) {
+                table_size_ *= 2;
+            }
+            // a box no wider than a cell covers at most two cells per axis, so the step loop
+            // only grows the entry lists once triangles stretch beyond their rest size
+            entry_buckets_.reserve(8 * triangles.size());
+            bucket_entries_.reserve(8 * triangles.size());
+        }
+
+        bool IsPrepared() const {
+            return !triangles_.empty();
+        }
+
+        // Resolves contacts in `state`, given the positions at the start of the step.
+        // Returns the number of corrected particles.
+        size_t Resolve(const std::vector<T>& inverse_masses, const std::vector<Vec3>& previous, State& state) {
+            if (!IsPrepared() || cell_size_ <= T(0)) {
+                return 0;
+            }
+            BuildHash(state.positions);
+
+            corrections_.assign(surface_.size(), Vec3(T(0)));
+            normals_.assign(surface_.size(), Vec3(T(0)));
+            ThreadPool::GetInstance().ParallelFor(surface_.size(), kGrain, [&](size_t begin, size_t end) {
+                for (size_t s = begin; s < end; s++) {
+                    if (inverse_masses[surface_[s]] != T(0)) {
+                        Query(s, previous, state.positions);
+                    }
+                }
+            });
+
+            size_t contacts = 0;
+            for (size_t s = 0; s < surface_.size(); s++) {
+                if (normals_[s] == Vec3(T(0))) {
+                    continue;
+                }
+                uint32_t i = surface_[s];
+                state.positions[i] += corrections_[s];
+                T approach = glm::dot(state.velocities[i], normals_[s]);
+                if (approach < T(0)) {
+                    state.velocities[i] -= approach * normals_[s];
+                }
+                contacts++;
+            }
+            return contacts;
+        }
+
+    private:
+        static const size_t kGrain = 128;
+        static constexpr T kMaxCellSpan = T(4); // cells per axis a triangle's box may cover
+
+        void Cell(const Vec3& p, int64_t cell[3]) const {
+            for (int axis = 0; axis < 3; axis++) {
+                cell[axis] = int64_t(std::floor(p[axis] / cell_size_));
+            }
+        }
+        size_t Hash(int64_t x, int64_t y, int64_t z) const {
+            uint64_t h = uint64_t(x) * 73856093u ^ uint64_t(y) * 19349663u ^ uint64_t(z) * 83492791u;
+            return size_t(h & (table_size_ - 1));
+        }
+
+        void BuildHash(const std::vector<Vec3>& p) {
+            // counting sort of (cell, triangle) entries into buckets. The boxes, their cells and
+            // the cells' buckets are worked out per triangle in parallel; only the sort itself,
+            // two integer passes over the entries, is serial. Scattering in parallel would take
+            // per-thread histograms of the whole table or atomic cursors, and the latter would
+            // make the bucket order, and with it which of two equally deep triangles wins,
+            // depend on scheduling.
+            size_t triangle_count = triangles_.size() / 3;
+            lo_.resize(triangle_count);
+            hi_.resize(triangle_count);
+            entry_starts_.resize(triangle_count + 1);
+            entry_starts_[0] = 0;
+            ThreadPool& pool = ThreadPool::GetInstance();
+            pool.ParallelFor(triangle_count, kGrain, [&](size_t begin, size_t end) {
+                for (size_t t = begin; t < end; t++) {
+                    Vec3 a = p[triangles_[3 * t]];
+                    Vec3 b = p[triangles_[3 * t + 1]];
+                    Vec3 c = p[triangles_[3 * t + 2]];
+                    lo_[t] = glm::min(glm::min(a, b), c) - Vec3(thickness_);
+                    hi_[t] = glm::max(glm::max(a, b), c) + Vec3(thickness_);
+                    size_t cells = 0;
+                    ForEachBucket(t, [&cells](size_t) { cells++; });
+                    entry_starts_[t + 1] = uint32_t(cells);
+                }
+            });
+            for (size_t t = 0; t < triangle_count; t++) {
+                entry_starts_[t + 1] += entry_starts_[t];
+            }
+            entry_buckets_.resize(entry_starts_[triangle_count]);
+            pool.ParallelFor(triangle_count, kGrain, [&](size_t begin, size_t end) {
+                for (size_t t = begin; t < end; t++) {
+                    uint32_t k = entry_starts_[t];
+                    ForEachBucket(t, [this, &k](size_t bucket) { entry_buckets_[k++] = uint32_t(bucket); });
+                }
+            });
+
+            bucket_offsets_.assign(table_size_ + 1, 0);
+            for (uint32_t bucket : entry_buckets_) {
+                bucket_offsets_[bucket + 1]++;
+            }
+            for (size_t b = 0; b < table_size_; b++) {
+                bucket_offsets_[b + 1] += bucket_offsets_[b];
+            }
+            bucket_entries_.resize(bucket_offsets_[table_size_]);
+            cursor_.assign(bucket_offsets_.begin(), bucket_offsets_.end() - 1);
+            for (size_t t = 0; t < triangle_count; t++) {
+                for (uint32_t k = entry_starts_[t]; k < entry_starts_[t + 1]; k++) {
+                    bucket_entries_[cursor_[entry_buckets_[k]]++] = uint32_t(t);
+                }
+            }
+        }
+
+        template <class F>
+        void ForEachBucket(size_t t, F f) const {
+            // the buckets of the cells triangle t's box covers
+            if (!InBox(hi_[t] - lo_[t], Vec3(T(0)), Vec3(kMaxCellSpan * cell_size_))) {
+                return; // stretched far beyond its rest size (or not finite): nothing sensible to collide with
+            }
+            int64_t lo[3], hi[3];
+            Cell(lo_[t], lo);
+            Cell(hi_[t], hi);
+            for (int64_t x = lo[0]; x <= hi[0]; x++) {
+                for (int64_t y = lo[1]; y <= hi[1]; y++) {
+                    for (int64_t z = lo[2]; z <= hi[2]; z++) {
+                        f(Hash(x, y, z));
+                    }
+                }
+            }
+        }
+
+        static bool InBox(const Vec3& x, const Vec3& lo, const Vec3& hi) {
+            // false for non-finite input
+            return x.x >= lo.x && x.y >= lo.y && x.z >= lo.z && x.x <= hi.x && x.y <= hi.y && x.z <= hi.z;
+        }
+
+        bool Adjacent(uint32_t i, size_t t) const {
+            auto begin = ring_.begin() + ring_offsets_[i];
+            auto end = ring_.begin() + ring_offsets_[i + 1];
+            for (int c = 0; c < 3; c++) {
+                uint32_t v = triangles_[3 * t + c];
+                if (v == i || std::binary_search(begin, end, v)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void Query(size_t s, const std::vector<Vec3>& previous, const std::vector<Vec3>& p) {
+            uint32_t i = surface_[s];
+            const Vec3& x = p[i];
+            if (!std::isfinite(x.x) || !std::isfinite(x.y) || !std::isfinite(x.z)) {
+                return;
+            }
+            int64_t cell[3];
+            Cell(x, cell);
+            size_t bucket = Hash(cell[0], cell[1], cell[2]);
+
+            T deepest = thickness_;
+            for (uint32_t k = bucket_offsets_[bucket]; k < bucket_offsets_[bucket + 1]; k++) {
+                uint32_t t = bucket_entries_[k];
+                if (!InBox(x, lo_[t], hi_[t]) || Adjacent(i, t)) {
+                    continue; // other cells hashed to this bucket, or the particle's own neighbourhood
+                }
+                uint32_t a = triangles_[3 * t];
+                uint32_t b = triangles_[3 * t + 1];
+                uint32_t c = triangles_[3 * t + 2];
+
+                // the side the particle started the step on
+                Vec3 previous_normal = glm::cross(previous[b] - previous[a], previous[c] - previous[a]);
+                T side = glm::dot(previous[i] - previous[a], previous_normal);
+                Vec3 normal = glm::cross(p[b] - p[a], p[c] - p[a]);
+                T length = glm::length(normal);
+                if (side == T(0) || length == T(0)) {
+                    continue;
+                }
+                normal = (side > T(0) ? T(1) : T(-1)) * normal / length;
+
+                // signed distance on the starting side, for points over the triangle's interior
+                T distance = glm::dot(x - p[a], normal);
+                if (distance >= deepest || distance < -cell_size_ || !OverTriangle(x, p[a], p[b], p[c], normal)) {
+                    continue;
+                }
+                deepest = distance;
+                corrections_[s] = (thickness_ - distance) * normal;
+                normals_[s] = normal;
+            }
+        }
+
+        static bool OverTriangle(const Vec3& x, const Vec3& a, const Vec3& b, const Vec3& c, const Vec3& normal) {
+            // x projects inside the triangle when it is on the same side of all three edges
+            T e0 = glm::dot(glm::cross(b - a, x - a), normal);
+            T e1 = glm::dot(glm::cross(c - b, x - b), normal);
+            T e2 = glm::dot(glm::cross(a - c, x - c), normal);
+            return (e0 >= T(0) && e1 >= T(0) && e2 >= T(0)) || (e0 <= T(0) && e1 <= T(0) && e2 <= T(0));
+        }
+
+        // topology
+        std::vector<uint32_t> triangles_; // three particle indices per triangle
+        std::vector<uint32_t> surface_; // particles on the surface
+        std::vector<uint32_t> ring_offsets_;
+        std::vector<uint32_t> ring_; // sorted one-ring neighbours
+        T thickness_ = T(0);
+        T cell_size_ = T(0);
+        size_t table_size_ = 1;
+
+        // per-step scratch
+        std::vector<Vec3> lo_;
+        std::vector<Vec3> hi_;
+        std::vector<uint32_t> entry_starts_; // per triangle, its first entry in entry_buckets_
+        std::vector<uint32_t> entry_buckets_; // bucket of every (cell, triangle) entry, by triangle
+        std::vector<uint32_t> bucket_offsets_;
+        std::vector<uint32_t> cursor_;
+        std::vector<uint32_t> bucket_entries_;
+        std::vector<Vec3> corrections_;
+        std::vector<Vec3> normals_;
+    };
+}  // namespace GLOO
+
+#endif
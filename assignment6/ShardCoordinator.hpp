@@ -0,0 +1,299 @@
+#ifndef SHARD_COORDINATOR_H_
+#define SHARD_COORDINATOR_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "BallSimulation.hpp"
+#include "Scenario.hpp"
+#include "SceneStep.hpp"
+#include "ShardTransport.hpp"
+
+
+namespace GLOO {
+    // Runs the bodies of a scenario in several worker processes, so a scene is
+    // no longer limited to one process's memory bandwidth. Each worker owns a
+    // shard of the bodies (balanced by particle count) and runs the same
+    // SceneStep as an in-process run, trading only the bodies' contact spheres
+    // (see BodyContact.hpp) at each exchange round; once per frame they
+    // publish their bodies' states, which this coordinator collects for
+    // rendering or recording. Particles never cross process boundaries.
+    //
+    // Every body sees the same spheres in the same order whatever the shard
+    // count, so the result does not depend on it and matches scenario_runner
+    // (given deterministic solvers, see BallParams::deterministic).
+    //
+    // Start forks the workers: call it before this process first uses the
+    // shared ThreadPool, whose threads do not survive fork. Unless GLOO_THREADS
+    // is set, each worker's pool gets an equal share of the cores.
+    class ShardCoordinator {
+    public:
+        // Per-body record at the start of its block in the States channel.
+        struct BodyFrame {
+            float volume = 0.f;
+            float rest_volume = 0.f;
+            uint32_t dropped = 0;
+            uint32_t asleep = 0;
+        };
+
+        ShardCoordinator(const Scenario& scenario, size_t shard_count) : scenario_(scenario) {
+            const size_t body_count = scenario_.bodies.size();
+            if (body_count == 0) {
+                throw std::runtime_error("A sharded run needs at least one body.");
+            }
+            shard_count = std::min(std::max<size_t>(shard_count, 1), body_count);
+
+            // topology only: particle counts, and triangles for exporting the collected states
+            interval_ = SceneStep::ExchangeInterval(scenario_);
+            size_t states_size = 0;
+            for (const ScenarioBody& body : scenario_.bodies) {
+                std::vector<glm::vec3> positions;
+                auto triangles = std::make_shared<std::vector<glm::vec3>>();
+                BallSimulation::BuildTopology(body.params, body.start_center, LoadMesh(body), positions, *triangles);
+                triangles_.push_back(triangles);
+                state_offsets_.push_back(states_size);
+                states_size += sizeof(BodyFrame) + 2 * positions.size() * sizeof(glm::vec3);
+                states_.push_back({ positions, std::vector<glm::vec3>(positions.size(), glm::vec3(0.f)) });
+                frames_.emplace_back();
+            }
+            frame_count_ = SceneStep::FrameCount(scenario_);
+
+            // longest processing time first: largest body to the least loaded shard
+            std::vector<size_t> order(body_count);
+            for (size_t b = 0; b < body_count; b++) {
+                order[b] = b;
+            }
+            std::stable_sort(order.begin(), order.end(),
+                             [this](size_t a, size_t b) { return states_[a].positions.size() > states_[b].positions.size(); });
+            std::vector<size_t> load(shard_count, 0);
+            shards_.resize(shard_count);
+            body_shards_.resize(body_count);
+            for (size_t b : order) {
+                size_t shard = size_t(std::min_element(load.begin(), load.end()) - load.begin());
+                load[shard] += states_[b].positions.size();
+                body_shards_[b] = shard;
+            }
+            for (size_t b = 0; b < body_count; b++) {
+                shards_[body_shards_[b]].push_back(b);
+            }
+
+            auto transport = new SharedMemoryTransport(shard_count, body_count * sizeof(ContactSphere), states_size);
+            transport_.reset(transport);
+            shared_bytes_ = transport->GetMappingSize();
+        }
+
+        ~ShardCoordinator() {
+            if (watchdog_.joinable()) {
+                if (frame_ < frame_count_) {
+                    transport_->Abort(); // stopped early: release the workers
+                }
+                watchdog_.join();
+            }
+        }
+
+        ShardCoordinator(const ShardCoordinator&) = delete;
+        ShardCoordinator& operator=(const ShardCoordinator&) = delete;
+
+        void Start() {
+            std::vector<pid_t> workers;
+            for (size_t shard = 0; shard < shards_.size(); shard++) {
+                pid_t pid = fork();
+                if (pid < 0) {
+                    transport_->Abort();
+                    throw std::runtime_error("Cannot fork a shard worker.");
+                }
+                if (pid == 0) {
+                    _exit(RunWorker(shard)); // never returns into the caller's code
+                }
+                workers.push_back(pid);
+            }
+            watchdog_ = std::thread([this, workers] { Watch(workers); });
+        }
+
+        // Waits for every body's state of the next frame. Returns false once the
+        // scenario's duration is covered; throws if a worker failed.
+        bool NextFrame() {
+            if (frame_ >= frame_count_) {
+                return false;
+            }
+            transport_->Barrier(ShardChannel::States);
+            for (size_t b = 0; b < states_.size(); b++) {
+                size_t offset = state_offsets_[b];
+                size_t bytes = states_[b].positions.size() * sizeof(glm::vec3);
+                transport_->Collect(ShardChannel::States, offset, &frames_[b], sizeof(BodyFrame));
+                offset += sizeof(BodyFrame);
+                transport_->Collect(ShardChannel::States, offset, states_[b].positions.data(), bytes);
+                transport_->Collect(ShardChannel::States, offset + bytes, states_[b].velocities.data(), bytes);
+            }
+            frame_++;
+            return true;
+        }
+
+        // Waits for the workers to exit after the last frame; throws if one failed.
+        void Finish() {
+            if (watchdog_.joinable()) {
+                watchdog_.join();
+            }
+            if (failed_.load()) {
+                throw std::runtime_error("A shard worker failed.");
+            }
+        }
+
+        size_t GetShardCount() const {
+            return shards_.size();
+        }
+        size_t GetBodyCount() const {
+            return states_.size();
+        }
+        size_t GetShard(size_t body) const {
+            return body_shards_[body];
+        }
+        int GetFrameCount() const {
+            return frame_count_;
+        }
+        int GetFrame() const {
+            return frame_; // frames collected so far
+        }
+        double GetExchangeInterval() const {
+            return interval_;
+        }
+        size_t GetSharedBytes() const {
+            return shared_bytes_;
+        }
+        const ParticleState& GetState(size_t body) const {
+            return states_[body];
+        }
+        const BodyFrame& GetBodyFrame(size_t body) const {
+            return frames_[body];
+        }
+        std::shared_ptr<const std::vector<glm::vec3>> GetTriangles(size_t body) const {
+            return triangles_[body];
+        }
+
+    private:
+        static SurfaceMeshT<float> LoadMesh(const ScenarioBody& body) {
+            return body.params.mesh.empty() ? SurfaceMeshT<float>() : MeshBodyBuilder<float>::ReadObj(body.params.mesh);
+        }
+
+        int RunWorker(size_t shard) {
+            ShardTransport& transport = *transport_;
+            try {
+                if (std::getenv("GLOO_THREADS") == nullptr) {
+                    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+                    setenv("GLOO_THREADS", std::to_string(std::max<size_t>(1, cores / shards_.size())).c_str(), 0);
+                }
+                const std::vector<size_t>& bodies = shards_[shard];
+                std::vector<std::unique_ptr<BallSimulation>> simulations;
+                std::vector<float> rest_volumes;
+                for (size_t b : bodies) {
+                    const ScenarioBody& body = scenario_.bodies[b];
+                    if (body.params.mesh.empty()) {
+                        simulations.emplace_back(new BallSimulation(body.params, body.start_center));
+                    }
+                    else {
+                        simulations.emplace_back(new BallSimulation(body.params, body.start_center, LoadMesh(body)));
+                    }
+                    simulations.back()->SetGround(scenario_.ground);
+                    if (body.dropped) {
+                        simulations.back()->Drop();
+                    }
+                    rest_volumes.push_back(float(simulations.back()->GetSystem().GetVolume()));
+                }
+
+                std::vector<BallSimulation*> shard_bodies;
+                for (const std::unique_ptr<BallSimulation>& simulation : simulations) {
+                    shard_bodies.push_back(simulation.get());
+                }
+                auto exchange = [&](std::vector<ContactSphere>& spheres) {
+                    for (size_t b : bodies) {
+                        transport.Publish(ShardChannel::Contacts, b * sizeof(ContactSphere), &spheres[b], sizeof(ContactSphere));
+                    }
+                    transport.Barrier(ShardChannel::Contacts);
+                    transport.Collect(ShardChannel::Contacts, 0, spheres.data(), spheres.size() * sizeof(ContactSphere));
+                };
+
+                SceneStep step(interval_);
+                std::vector<ContactSphere> spheres(states_.size());
+                for (int frame = 0; frame < frame_count_; frame++) {
+                    step.AdvanceThrough(frame, scenario_.frame_rate, shard_bodies, bodies, spheres, exchange);
+
+                    for (size_t k = 0; k < bodies.size(); k++) {
+                        const BallSimulation& simulation = *simulations[k];
+                        const ParticleState& state = simulation.GetState();
+                        BodyFrame record;
+                        record.volume = float(simulation.GetSystem().GetVolume());
+                        record.rest_volume = rest_volumes[k];
+                        record.dropped = simulation.IsDropped();
+                        record.asleep = simulation.IsAsleep();
+                        size_t offset = state_offsets_[bodies[k]];
+                        size_t bytes = state.positions.size() * sizeof(glm::vec3);
+                        transport.Publish(ShardChannel::States, offset, &record, sizeof(record));
+                        offset += sizeof(record);
+                        transport.Publish(ShardChannel::States, offset, state.positions.data(), bytes);
+                        transport.Publish(ShardChannel::States, offset + bytes, state.velocities.data(), bytes);
+                    }
+                    transport.Barrier(ShardChannel::States);
+                }
+                return 0;
+            } catch (const std::exception& e) {
+                if (!transport.IsAborted()) { // the first failure, not the others' reaction to it
+                    fprintf(stderr, "Shard %zu: %s\n", shard, e.what());
+                }
+                transport.Abort();
+                return 1;
+            }
+        }
+
+        void Watch(std::vector<pid_t> workers) {
+            // polls instead of waiting on one worker at a time, so any failure aborts the run at once
+            while (!workers.empty()) {
+                for (size_t w = 0; w < workers.size();) {
+                    int status = 0;
+                    pid_t pid = waitpid(workers[w], &status, WNOHANG);
+                    if (pid == 0) {
+                        w++;
+                        continue;
+                    }
+                    if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                        failed_.store(true);
+                        transport_->Abort();
+                    }
+                    workers.erase(workers.begin() + w);
+                }
+                if (!workers.empty()) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                }
+            }
+        }
+
+        Scenario scenario_;
+        double interval_ = 0.0; // s between contact exchanges
+        int frame_count_ = 0;
+        int frame_ = 0;
+        std::vector<std::vector<size_t>> shards_; // bodies of each shard, ascending
+        std::vector<size_t> body_shards_;
+        std::vector<size_t> state_offsets_; // byte offset of each body in the States channel
+        std::vector<ParticleState> states_; // as of the last collected frame
+        std::vector<BodyFrame> frames_;
+        std::vector<std::shared_ptr<const std::vector<glm::vec3>>> triangles_;
+
+        std::unique_ptr<ShardTransport> transport_;
+        size_t shared_bytes_ = 0;
+        std::atomic<bool> failed_{ false };
+        std::thread watchdog_;
+    };
+}  // namespace GLOO
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef SHARD_TRANSPORT_H_
+#define SHARD_TRANSPORT_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <sys/mman.h>
+
+
+namespace GLOO {
+    // Data exchanged between the processes of a sharded run (see ShardCoordinator.hpp).
+    enum class ShardChannel {
+        Contacts, // every body's ContactSphere, once per exchange step; workers only
+        States, // every body's state, once per frame; workers and the coordinator
+    };
+
+    // How the processes of a sharded run exchange data. Each channel is a fixed
+    // block of bytes exchanged in rounds: participants Publish their own,
+    // disjoint byte ranges, Barrier completes the round once every participant
+    // of the channel has arrived, and Collect then reads any range of the
+    // completed round. Publishing the next round may start while others still
+    // read the last one.
+    //
+    // Transports are per process. SharedMemoryTransport serves processes forked
+    // from one coordinator on one machine; a socket transport would implement
+    // the same rounds across machines.
+    class ShardTransport {
+    public:
+        virtual ~ShardTransport() {
+        }
+
+        virtual size_t GetChannelSize(ShardChannel channel) const = 0;
+        virtual void Publish(ShardChannel channel, size_t offset, const void* data, size_t size) = 0;
+        virtual void Collect(ShardChannel channel, size_t offset, void* data, size_t size) = 0;
+        // Throws std::runtime_error once the run was aborted.
+        virtual void Barrier(ShardChannel channel) = 0;
+
+        // Makes every participant's pending and future Barrier throw, e.g. when a
+        // worker failed, so nobody waits forever.
+        virtual void Abort() = 0;
+        virtual bool IsAborted() const = 0;
+    };
+
+    // Channels live in one anonymous shared mapping created before the workers
+    // are forked, so it needs no name and cannot outlive the run. Each channel
+    // is double-buffered by round parity; the barriers are atomic counters in
+    // the mapping (lock-free atomics work across processes) that waiters poll,
+    // yielding and then sleeping briefly, since the runs may oversubscribe cores.
+    class SharedMemoryTransport : public ShardTransport {
+    public:
+        SharedMemoryTransport(size_t worker_count, size_t contacts_size, size_t states_size) {
+            static_assert(ATOMIC_INT_LOCK_FREE == 2, "barriers need address-free atomics");
+            sizes_[0] = contacts_size;
+            sizes_[1] = states_size;
+            size_t offset = Align(sizeof(Header));
+            for (int c = 0; c < 2; c++) {
+                for (int parity = 0; parity < 2; parity++) {
+                    offsets_[c][parity] = offset;
+                    offset += Align(sizes_[c]);
+                }
+            }
+            mapping_size_ = offset;
+            void* mapping = mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+            if (mapping == MAP_FAILED) {
+                throw std::runtime_error("Cannot map " + std::to_string(mapping_size_) + " bytes of shared memory.");
+            }
+            base_ = static_cast<char*>(mapping);
+            header_ = new (base_) Header();
+            header_->barriers[0].participants = uint32_t(worker_count);
+            header_->barriers[1].participants = uint32_t(worker_count + 1); // the coordinator collects every frame
+        }
+
+        ~SharedMemoryTransport() override {
+            munmap(base_, mapping_size_);
+        }
+
+        SharedMemoryTransport(const SharedMemoryTransport&) = delete;
+        SharedMemoryTransport& operator=(const SharedMemoryTransport&) = delete;
+
+        size_t GetChannelSize(ShardChannel channel) const override {
+            return sizes_[int(channel)];
+        }
+        size_t GetMappingSize() const {
+            return mapping_size_;
+        }
+
+        void Publish(ShardChannel channel, size_t offset, const void* data, size_t size) override {
+            int c = int(channel);
+            CheckRange(c, offset, size);
+            std::memcpy(base_ + offsets_[c][rounds_[c] % 2] + offset, data, size);
+        }
+
+        void Collect(ShardChannel channel, size_t offset, void* data, size_t size) override {
+            int c = int(channel);
+            CheckRange(c, offset, size);
+            if (rounds_[c] == 0) {
+                throw std::logic_error("Collect before the first completed round.");
+            }
+            std::memcpy(data, base_ + offsets_[c][(rounds_[c] - 1) % 2] + offset, size);
+        }
+
+        void Barrier(ShardChannel channel) override {
+            int c = int(channel);
+            SharedBarrier& barrier = header_->barriers[c];
+            uint32_t generation = barrier.generation.load(std::memory_order_acquire);
+            if (barrier.arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == barrier.participants) {
+                barrier.arrived.store(0, std::memory_order_relaxed);
+                barrier.generation.fetch_add(1, std::memory_order_release);
+            }
+            else {
+                for (int spin = 0; barrier.generation.load(std::memory_order_acquire) == generation; spin++) {
+                    if (IsAborted()) {
+                        throw std::runtime_error("Sharded run aborted.");
+                    }
+                    if (spin < 1000) {
+                        std::this_thread::yield();
+                    }
+                    else {
+                        std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    }
+                }
+            }
+            rounds_[c]++;
+        }
+
+        void Abort() override {
+            header_->aborted.store(1, std::memory_order_release);
+        }
+        bool IsAborted() const override {
+            return header_->aborted.load(std::memory_order_acquire) != 0;
+        }
+
+    private:
+        struct SharedBarrier {
+            std::atomic<uint32_t> arrived{ 0 };
+            std::atomic<uint32_t> generation{ 0 };
+            uint32_t participants = 0;
+        };
+        struct Header {
+            SharedBarrier barriers[2];
+            std::atomic<uint32_t> aborted{ 0 };
+        };
+
+        static size_t Align(size_t size) {
+            return (size + 63) & ~size_t(63); // channels start on their own cache lines
+        }
+        void CheckRange(int c, size_t offset, size_t size) const {
+            if (offset > sizes_[c] || size > sizes_[c] - offset) {
+                throw std::out_of_range("Shard channel range out of bounds.");
+            }
+        }
+
+        char* base_ = nullptr;
+        Header* header_ = nullptr;
+        size_t mapping_size_ = 0;
+        size_t sizes_[2];
+        size_t offsets_[2][2]; // [channel][round parity]
+        uint64_t rounds_[2] = { 0, 0 }; // completed rounds, counted by this process
+    };
+}  // namespace GLOO
+
+#endif
@@ -1,5 +1,7 @@
 #include "SimulationApp.hpp"
 
+#include <cfloat>
+
 #include "glm/gtx/string_cast.hpp"
 
 #include "gloo/shaders/PhongShader.hpp"
@@ -14,7 +16,9 @@
 #include "gloo/cameras/ArcBallCameraNode.hpp"
 #include "gloo/debug/AxisNode.hpp"
 #include "gloo/debug/PrimitiveFactory.hpp"
+#include "AllocationTracker.hpp"
 #include "BallNode.hpp"
+#include "ContactNode.hpp"
 #include "GroundNode.hpp"
 
 
@@ -22,10 +26,21 @@ namespace GLOO {
   SimulationApp::SimulationApp(const std::string& app_name,
                               glm::ivec2 window_size,
                               IntegratorType integrator_type,
-                              float integration_step)
+                              float integration_step,
+                              const std::string& mesh_path)
       : Application(app_name, window_size),
         integrator_type_(integrator_type),
-        integration_step_(integration_step) {
+        integration_step_(integration_step),
+        mesh_path_(mesh_path) {
+  }
+
+  SimulationApp::SimulationApp(const std::string& app_name,
+                               glm::ivec2 window_size,
+                               const Scenario& scenario)
+      : Application(app_name, window_size),
+        integrator_type_(IntegratorType::RK4),
+        integration_step_(0.f),
+        scenario_(scenario) {
   }
 
   void SimulationApp::SetupScene() {
@@ -33,6 +48,7 @@ namespace GLOO {
 
     auto camera_node = make_unique<ArcBallCameraNode>(45.f, 0.75f, 5.0f);
     scene_->ActivateCamera(camera_node->GetComponentPtr<CameraComponent>());
+    SceneNode* camera_ptr = camera_node.get();
     root.AddChild(std::move(camera_node));
 
     root.AddChild(make_unique<AxisNode>('A'));
@@ -50,37 +66,217 @@ namespace GLOO {
     point_light_node->GetTransform().SetPosition(glm::vec3(3.0f, 5.0f, 0.f));
     root.AddChild(std::move(point_light_node));
 
-    auto ball_node = make_unique<BallNode>(integrator_type_, integration_step_);
-    ball_node_ptr_ = ball_node.get();
-    root.AddChild(std::move(ball_node));
-
-    float *height = &ball_height_;
-    float *x = &ball_x_;
-    float *z = &ball_z_;
-    ball_node_ptr_->LinkControl(height, x, z);
-    ball_node_ptr_->OnParamsChanged();
+    if (scenario_.bodies.empty()) {
+      ball_controls_.reserve(1);
+      AddBall(make_unique<BallNode>(integrator_type_, integration_step_, mesh_path_),
+              glm::vec3(0.f, 1.f, 0.f), camera_ptr);
+    } else {
+      ball_controls_.reserve(scenario_.bodies.size());
+      // Ahead of the balls, so the scene updates it first every frame. The balls
+      // step themselves by the frame time, so contacts are exchanged once per
+      // frame, not once per step as in SceneStep's headless rounds: a ball
+      // moves up to a frame's worth of steps into another before it is pushed
+      // back, and interactive contacts sink in deeper than scenario_runner's.
+      auto contact_node = make_unique<ContactNode>();
+      ContactNode* contacts = contact_node.get();
+      root.AddChild(std::move(contact_node));
+      for (const ScenarioBody& body : scenario_.bodies) {
+        BallNode* ball = AddBall(
+            make_unique<BallNode>(BallNode::InteractiveParams(body.params)),
+            body.start_center, camera_ptr);
+        ball->SetGround(scenario_.ground);
+        if (body.dropped) {
+          ball->Drop();
+        }
+        contacts->AddBall(ball);
+      }
+    }
+    ball_node_ptr_ = ball_node_ptrs_[0];
 
-    auto ground_node = make_unique<GroundNode>();
+    auto ground_node = make_unique<GroundNode>(scenario_.ground);
     root.AddChild(std::move(ground_node));
   }
 
+  BallNode* SimulationApp::AddBall(std::unique_ptr<BallNode> ball_node,
+                                   glm::vec3 start_center,
+                                   SceneNode* camera_ptr) {
+    BallNode* ball = ball_node.get();
+    scene_->GetRootNode().AddChild(std::move(ball_node));
+    ball_node_ptrs_.push_back(ball);
+
+    ball_controls_.push_back({start_center.y, start_center.x, start_center.z});
+    float* height = &ball_controls_.back().height;
+    float* x = &ball_controls_.back().x;
+    float* z = &ball_controls_.back().z;
+    ball->LinkControl(height, x, z);
+    ball->LinkCamera(camera_ptr);
+    ball->OnParamsChanged();
+    return ball;
+  }
+
   void SimulationApp::DrawGUI() {
     bool modified = false;
     ImGui::Begin("Controls");
     ImGui::Text("Ball Parameters");
+    if (ball_node_ptrs_.size() > 1) {
+      ImGui::SliderInt("Ball", &selected_ball_, 0, int(ball_node_ptrs_.size()) - 1);
+      ball_node_ptr_ = ball_node_ptrs_[selected_ball_];
+    }
+    BallControl& control = ball_controls_[selected_ball_];
     ImGui::PushID(0);
-    modified |= ImGui::SliderFloat("y (height)", &ball_height_, 0.0, 6);
+    modified |= ImGui::SliderFloat("y (height)", &control.height, 0.0, 6);
     ImGui::PopID();
     ImGui::PushID(1);
-    modified |= ImGui::SliderFloat("x", &ball_x_, -10, 10);
+    modified |= ImGui::SliderFloat("x", &control.x, -10, 10);
     ImGui::PopID();
     ImGui::PushID(2);
-    modified |= ImGui::SliderFloat("z", &ball_z_, -10, 10);
+    modified |= ImGui::SliderFloat("z", &control.z, -10, 10);
     ImGui::PopID();
+
+    ImGui::Separator();
+    ImGui::Text("Views (built when first shown)");
+    for (int v = 0; v < kBallViewCount; v++) {
+      bool visible = ball_node_ptr_->IsViewVisible(BallView(v));
+      if (ImGui::Checkbox(kBallViewNames[v], &visible)) {
+        ball_node_ptr_->SetViewVisible(BallView(v), visible);
+      }
+    }
+
+    ImGui::Separator();
+    const BallSimulation::StepStats& stats = ball_node_ptr_->GetStepStats();
+    ImGui::Text("Simulated %.2f s, dropped %.3f s (%d capped frames)",
+                stats.simulated_time, stats.dropped_time, stats.capped_calls);
+    ImGui::Text("Substeps last frame: %d", stats.last_substeps);
+    int max_substeps = ball_node_ptr_->GetMaxSubsteps();
+    if (ImGui::SliderInt("Max substeps/frame", &max_substeps, 1, 1000)) {
+      ball_node_ptr_->SetMaxSubsteps(max_substeps);
+    }
+
+    ImGui::Separator();
+    const StateHistory<float>& history = ball_node_ptr_->GetHistory();
+    ImGui::Text("Timeline: %d frames, %.1f / %.0f MB", int(history.GetFrameCount()),
+                history.GetMemoryUsage() / 1048576.0, history.GetMemoryBudget() / 1048576.0);
+    ImGui::Checkbox("Record history", &ball_node_ptr_->RecordHistory());
+    if (history.GetFrameCount() > 0) {
+      int frame = ball_node_ptr_->IsScrubbing()
+                      ? int(ball_node_ptr_->GetScrubFrame())
+                      : int(history.GetFrameCount()) - 1;
+      if (ImGui::SliderInt("Frame", &frame, 0, int(history.GetFrameCount()) - 1)) {
+        ball_node_ptr_->ScrubTo(size_t(frame));
+      }
+      ImGui::Text("t = %.3f s", history.GetFrameInfo(size_t(frame)).time);
+      if (ball_node_ptr_->IsScrubbing()) {
+        ImGui::SameLine();
+        if (ImGui::Button("Resume here")) {
+          ball_node_ptr_->ResumeFromHistory();
+        }
+      }
+    }
+
+    ImGui::Separator();
+    ImGui::Text("Level of Detail (current: %d)", ball_node_ptr_->GetLevel());
+    LodSettings& lod = ball_node_ptr_->GetLodSettings();
+    ImGui::Checkbox("Adaptive level", &lod.enabled);
+    ImGui::Checkbox("By CPU budget (else distance)", &lod.by_budget);
+    ImGui::SliderInt("Min level", &lod.min_level, 0, 4);
+    ImGui::SliderInt("Max level", &lod.max_level, lod.min_level, 4);
+    if (lod.by_budget) {
+      ImGui::SliderFloat("Budget (ms/frame)", &lod.frame_budget_ms, 0.5f, 33.f);
+    } else {
+      ImGui::SliderFloat("Full-detail distance", &lod.near_distance, 0.5f, 10.f);
+    }
     ImGui::End();
 
     if (modified) {
       ball_node_ptr_->OnParamsChanged();
     }
+
+    DrawDiagnostics();
+    DrawExport();
+    DrawAllocations();
+  }
+
+  void SimulationApp::DrawAllocations() {
+    if (!AllocationTracker::IsEnabled()) {
+      return; // only builds with -DGLOO_TRACK_ALLOCATIONS count anything
+    }
+    AllocationTracker& tracker = AllocationTracker::GetInstance();
+    ImGui::Begin("Allocations");
+    AllocationCounts last = tracker.GetLastFrame();
+    ImGui::Text("last frame: %llu allocations, %.1f KB", (unsigned long long)last.allocations,
+                last.bytes / 1024.0);
+    if (ImGui::Button("Reset")) {
+      tracker.Reset();
+    }
+    AllocationTracker::Phase phases[AllocationTracker::kMaxPhases];
+    int count = tracker.GetPhases(phases);
+    ImGui::Text("%-38s %10s %10s %10s", "phase (inclusive)", "frame", "KB/frame", "worst");
+    for (int p = 0; p < count; p++) {
+      ImGui::Text("%-38s %10llu %10.1f %10llu", phases[p].name,
+                  (unsigned long long)phases[p].last_frame.allocations,
+                  phases[p].last_frame.bytes / 1024.0,
+                  (unsigned long long)phases[p].worst_frame.allocations);
+    }
+    ImGui::End();
+  }
+
+  void SimulationApp::DrawExport() {
+    ImGui::Begin("Mesh Export");
+    ImGui::RadioButton("Binary PLY", &export_format_, int(MeshFormat::PLY));
+    ImGui::SameLine();
+    ImGui::RadioButton("OBJ", &export_format_, int(MeshFormat::OBJ));
+    bool exporting = exporter_ != nullptr;
+    if (ImGui::Checkbox("Export frames to the working directory", &exporting)) {
+      if (exporting) {
+        exporter_ = make_unique<MeshExporter>(".", MeshFormat(export_format_));
+        for (size_t b = 0; b < ball_node_ptrs_.size(); b++) {
+          ball_node_ptrs_[b]->SetExporter(
+              exporter_.get(),
+              ball_node_ptrs_.size() == 1 ? "ball" : "ball" + std::to_string(b));
+        }
+      } else {
+        for (BallNode* ball : ball_node_ptrs_) {
+          ball->SetExporter(nullptr, "");
+        }
+        exporter_.reset(); // waits for the queued frames
+      }
+    }
+    if (exporter_ != nullptr) {
+      exporter_->SetFormat(MeshFormat(export_format_));
+      ImGui::Text("written %d, queued %d, dropped %d, failed %d", int(exporter_->GetWritten()),
+                  int(exporter_->GetPending()), int(exporter_->GetDropped()), int(exporter_->GetFailed()));
+      for (const auto& body : exporter_->GetDroppedByBody()) {
+        ImGui::Text("  %s: dropped %d", body.first.c_str(), int(body.second));
+      }
+    }
+    ImGui::End();
+  }
+
+  void SimulationApp::DrawDiagnostics() {
+    DiagnosticsRecorder& diagnostics = ball_node_ptr_->GetDiagnostics();
+    ImGui::Begin("Diagnostics");
+    ImGui::Checkbox("Record", &ball_node_ptr_->RecordDiagnostics());
+    ImGui::SameLine();
+    bool streaming = diagnostics.IsStreaming();
+    if (ImGui::Checkbox("Stream to diagnostics.csv", &streaming)) {
+      if (streaming) {
+        diagnostics.StartCsv("diagnostics.csv");
+      } else {
+        diagnostics.StopCsv();
+      }
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) {
+      diagnostics.Clear();
+    }
+
+    const DiagnosticsSample& last = diagnostics.GetLast();
+    ImGui::Text("t = %.3f s  E = %.5g J  V = %.5g", last.time, last.total, last.volume);
+    for (int c = 0; c < DiagnosticsRecorder::kChannelCount; c++) {
+      ImGui::PlotLines(DiagnosticsRecorder::ChannelName(c), diagnostics.GetRing(c),
+                       diagnostics.GetCount(), diagnostics.GetOffset(), nullptr,
+                       FLT_MAX, FLT_MAX, ImVec2(0.f, 50.f));
+    }
+    ImGui::End();
   }
 }  // namespace GLOO
@@ -5,6 +5,7 @@
 
 #include "IntegratorType.hpp"
 #include "BallNode.hpp"
+#include "Scenario.hpp"
 
 namespace GLOO {
 class SimulationApp : public Application {
@@ -12,21 +13,43 @@ class SimulationApp : public Application {
     SimulationApp(const std::string& app_name,
                   glm::ivec2 window_size,
                   IntegratorType integrator_type,
-                  float integration_step);
+                  float integration_step,
+                  const std::string& mesh_path = "");
+    // Sets up the bodies and ground of a scenario instead of the single ball.
+    SimulationApp(const std::string& app_name,
+                  glm::ivec2 window_size,
+                  const Scenario& scenario);
     void SetupScene() override;
 
   protected:
     void DrawGUI() override;
+    void DrawDiagnostics();
+    void DrawExport();
+    void DrawAllocations();
+
+  private:
+    BallNode* AddBall(std::unique_ptr<BallNode> ball_node,
+                      glm::vec3 start_center,
+                      SceneNode* camera_ptr);
 
   private:
     IntegratorType integrator_type_;
     float integration_step_;
+    std::string mesh_path_; // soft body surface; empty for the icosphere
+    Scenario scenario_; // no bodies: one ball from the settings above
+    std::unique_ptr<MeshExporter> exporter_; // while exporting frames
+    int export_format_ = 0; // MeshFormat
 
     // GUI stuff
-    BallNode* ball_node_ptr_;
-    float ball_height_ = 1.f;
-    float ball_x_ = 0.f;
-    float ball_z_ = 0.f;
+    struct BallControl {
+      float height;
+      float x;
+      float z;
+    };
+    std::vector<BallNode*> ball_node_ptrs_;
+    std::vector<BallControl> ball_controls_; // linked to the balls; never reallocated after setup
+    int selected_ball_ = 0;
+    BallNode* ball_node_ptr_; // the selected ball
 };
 }  // namespace GLOO
 
@@ -0,0 +1,46 @@
+#ifndef SPRING_GROUP_H_
+#define SPRING_GROUP_H_
+
+#include <cstdint>
+#include <vector>
+
+
+namespace GLOO {
+    // Springs sharing one stiffness. The kind selects a force kernel that is
+    // specialized at compile time (e.g. radial springs all share the center).
+    // Bending springs join the far corners of two faces sharing an edge.
+    enum class SpringKind { Radial, Chordal, Surface, Bending };
+
+    template <class T>
+    struct SpringGroupT {
+        SpringKind kind;
+        T k; // stiffness shared by every spring in the group
+        std::vector<uint32_t> first; // endpoint indices, stored separately so kernels stream them
+        std::vector<uint32_t> second;
+        std::vector<T> rest_lengths;
+
+        size_t size() const {
+            return rest_lengths.size();
+        }
+
+        void reserve(size_t n) {
+            first.reserve(n);
+            second.reserve(n);
+            rest_lengths.reserve(n);
+        }
+
+        void resize(size_t n) {
+            first.resize(n);
+            second.resize(n);
+            rest_lengths.resize(n);
+        }
+
+        void push_back(uint32_t i, uint32_t j, T r) {
+            first.push_back(i);
+            second.push_back(j);
+            rest_lengths.push_back(r);
+        }
+    };
+}  // namespace GLOO
+
+#endif
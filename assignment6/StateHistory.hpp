@@ -0,0 +1,196 @@
+#ifndef STATE_HISTORY_H_
+#define STATE_HISTORY_H_
+
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include "ParticleState.hpp"
+
+
+namespace GLOO {
+    // Rewind buffer of recent particle states under a memory budget. Positions
+    // and velocities are quantized to fixed steps; every kKeyInterval-th frame
+    // stores them whole, the frames in between store the change since the
+    // previous frame, zigzag/varint encoded, so a slowly moving ball costs a
+    // few bytes per particle. When the budget is exceeded the oldest key frame
+    // and its dependent frames are dropped together.
+    //
+    // Deltas are taken between quantized values, so restoring a frame is exact
+    // up to the quantization step no matter how far it is from its key frame.
+    template <class T>
+    class StateHistory {
+    public:
+        using Vec3 = glm::vec<3, T>;
+        using State = ParticleStateT<T>;
+
+        // One restorable frame, with whatever the caller needs alongside the particles.
+        struct FrameInfo {
+            double time = 0.0;
+            int level = 0;
+            bool dropped = false;
+            bool asleep = false;
+        };
+
+        explicit StateHistory(size_t memory_budget = 64u << 20, double position_step = 1e-5, double velocity_step = 1e-4)
+            : memory_budget_(memory_budget), position_step_(position_step), velocity_step_(velocity_step) {
+        }
+
+        void Record(const State& state, const FrameInfo& info) {
+            size_t count = state.positions.size();
+            bool key = frames_.empty() || since_key_ + 1 >= kKeyInterval || count != previous_.size() / 6;
+            since_key_ = key ? 0 : since_key_ + 1;
+
+            Frame frame;
+            frame.info = info;
+            frame.key = key;
+            frame.count = count;
+            previous_.resize(6 * count, 0);
+            for (size_t i = 0; i < count; i++) {
+                for (int c = 0; c < 3; c++) { // in slot order, as Restore reads them back
+                    Encode(Quantize(state.positions[i][c], position_step_), 6 * i + c, key, frame.bytes);
+                }
+                for (int c = 0; c < 3; c++) {
+                    Encode(Quantize(state.velocities[i][c], velocity_step_), 6 * i + 3 + c, key, frame.bytes);
+                }
+            }
+            frame.bytes.shrink_to_fit();
+            bytes_ += frame.bytes.size();
+            key_frames_ += key ? 1 : 0;
+            frames_.push_back(std::move(frame));
+
+            // evict whole key-frame groups, always keeping the newest group
+            while (bytes_ > memory_budget_ && key_frames_ > 1) {
+                key_frames_--;
+                do {
+                    bytes_ -= frames_.front().bytes.size();
+                    frames_.pop_front();
+                } while (!frames_.front().key);
+            }
+        }
+
+        // Rebuilds frame k (0 is the oldest retained frame). Returns false if k is out of range.
+        bool Restore(size_t k, State& state, FrameInfo& info) const {
+            if (k >= frames_.size()) {
+                return false;
+            }
+            size_t key = k;
+            while (!frames_[key].key) {
+                key--;
+            }
+            size_t count = frames_[k].count;
+            std::vector<int64_t> values(6 * count, 0);
+            for (size_t f = key; f <= k; f++) {
+                const uint8_t* cursor = frames_[f].bytes.data();
+                for (int64_t& value : values) {
+                    value = (f == key ? 0 : value) + Decode(cursor);
+                }
+            }
+            state.positions.resize(count);
+            state.velocities.resize(count);
+            for (size_t i = 0; i < count; i++) {
+                for (int c = 0; c < 3; c++) {
+                    state.positions[i][c] = T(values[6 * i + c] * position_step_);
+                    state.velocities[i][c] = T(values[6 * i + 3 + c] * velocity_step_);
+                }
+            }
+            info = frames_[k].info;
+            return true;
+        }
+
+        // Forgets every frame after k, so recording resumes from it.
+        void Truncate(size_t k) {
+            while (frames_.size() > k + 1) {
+                bytes_ -= frames_.back().bytes.size();
+                key_frames_ -= frames_.back().key ? 1 : 0;
+                frames_.pop_back();
+            }
+            // the next frame is delta-encoded against frame k, so rebuild its values
+            State state;
+            FrameInfo info;
+            if (Restore(k, state, info)) {
+                since_key_ = 0;
+                for (size_t f = k; !frames_[f].key; f--) {
+                    since_key_++;
+                }
+                previous_.assign(6 * state.positions.size(), 0);
+                for (size_t i = 0; i < state.positions.size(); i++) {
+                    for (int c = 0; c < 3; c++) {
+                        previous_[6 * i + c] = Quantize(state.positions[i][c], position_step_);
+                        previous_[6 * i + 3 + c] = Quantize(state.velocities[i][c], velocity_step_);
+                    }
+                }
+            }
+        }
+
+        void Clear() {
+            frames_.clear();
+            previous_.clear();
+            bytes_ = 0;
+            key_frames_ = 0;
+            since_key_ = 0;
+        }
+
+        size_t GetFrameCount() const {
+            return frames_.size();
+        }
+        const FrameInfo& GetFrameInfo(size_t k) const {
+            return frames_[k].info;
+        }
+        size_t GetMemoryUsage() const {
+            return bytes_;
+        }
+        size_t GetMemoryBudget() const {
+            return memory_budget_;
+        }
+
+    private:
+        static const size_t kKeyInterval = 60;
+
+        struct Frame {
+            FrameInfo info;
+            bool key = false;
+            size_t count = 0;
+            std::vector<uint8_t> bytes;
+        };
+
+        static int64_t Quantize(T value, double step) {
+            return std::isfinite(value) ? int64_t(std::llround(double(value) / step)) : 0;
+        }
+
+        void Encode(int64_t value, size_t slot, bool key, std::vector<uint8_t>& bytes) {
+            int64_t delta = key ? value : value - previous_[slot];
+            previous_[slot] = value;
+            uint64_t zigzag = (uint64_t(delta) << 1) ^ uint64_t(delta >> 63);
+            while (zigzag >= 0x80) {
+                bytes.push_back(uint8_t(zigzag | 0x80));
+                zigzag >>= 7;
+            }
+            bytes.push_back(uint8_t(zigzag));
+        }
+
+        static int64_t Decode(const uint8_t*& cursor) {
+            uint64_t zigzag = 0;
+            for (int shift = 0;; shift += 7) {
+                uint8_t byte = *cursor++;
+                zigzag |= uint64_t(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) {
+                    break;
+                }
+            }
+            return int64_t(zigzag >> 1) ^ -int64_t(zigzag & 1);
+        }
+
+        size_t memory_budget_;
+        double position_step_; // m
+        double velocity_step_; // m/s
+        std::deque<Frame> frames_;
+        std::vector<int64_t> previous_; // quantized values of the newest frame, six per particle
+        size_t bytes_ = 0;
+        size_t key_frames_ = 0;
+        size_t since_key_ = 0; // frames recorded since the newest key frame
+    };
+}  // namespace GLOO
+
+#endif
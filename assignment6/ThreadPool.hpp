@@ -0,0 +1,252 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+namespace GLOO {
+    // Work-stealing pool. Each worker owns a deque: it pops its own newest
+    // task and, when empty, steals the oldest task of another worker. Threads
+    // that wait on a TaskGroup run queued tasks meanwhile, so tasks may spawn
+    // and wait on nested work (e.g. a batch of simulations whose solvers use
+    // ParallelFor) without deadlocking or oversubscribing the machine.
+    //
+    // Queued work is a plain slot (function pointer, context, index range), and
+    // each deque is a ring buffer that only grows when full, so ParallelFor
+    // queues its chunks without allocating once the rings have warmed up.
+    class ThreadPool {
+    public:
+        using Task = std::function<void()>;
+
+        // Completion counter for a set of submitted tasks.
+        class TaskGroup {
+        public:
+            bool Done() const {
+                return pending_.load() == 0;
+            }
+
+        private:
+            friend class ThreadPool;
+            std::atomic<size_t> pending_{ 0 };
+        };
+
+        explicit ThreadPool(size_t thread_count = std::max(1u, std::thread::hardware_concurrency())) {
+            thread_count = std::max<size_t>(thread_count, 1);
+            for (size_t q = 0; q < thread_count; q++) {
+                queues_.emplace_back(new WorkQueue());
+            }
+            for (size_t t = 1; t < thread_count; t++) { // queue 0 is fed by outside threads
+                workers_.emplace_back([this, t] { WorkerLoop(t); });
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(sleep_mutex_);
+                stopping_ = true;
+            }
+            wake_.notify_all();
+            for (std::thread& worker : workers_) {
+                worker.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // The shared pool. GLOO_THREADS, when set, overrides the thread count,
+        // e.g. to check that deterministic results do not depend on it.
+        static ThreadPool& GetInstance() {
+            static ThreadPool pool(DefaultThreadCount());
+            return pool;
+        }
+
+        size_t GetThreadCount() const {
+            return queues_.size();
+        }
+
+        // Queues an arbitrary callable; it is boxed on the heap (ParallelFor is the allocation-free path).
+        void Submit(TaskGroup& group, Task task) {
+            Push(group, &RunBoxed, new Task(std::move(task)), 0, 0);
+        }
+
+        void Wait(TaskGroup& group) {
+            // help with queued work until every task of the group has finished
+            while (!group.Done()) {
+                if (!RunOne(CurrentQueue())) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        // Calls body(begin, end) over chunks of at most `grain` indices covering [0, count).
+        // Ranges no larger than one grain run inline without touching the workers.
+        // The body is taken by its own type, not wrapped in a std::function, so the
+        // inline path never allocates (reference-capturing lambdas outgrow its small buffer).
+        template <class Body>
+        void ParallelFor(size_t count, size_t grain, const Body& body) {
+            grain = std::max<size_t>(grain, 1);
+            if (count <= grain || queues_.size() == 1) {
+                if (count > 0) {
+                    body(0, count);
+                }
+                return;
+            }
+            TaskGroup group;
+            void* context = const_cast<void*>(static_cast<const void*>(&body));
+            for (size_t begin = grain; begin < count; begin += grain) {
+                Push(group, &RunRange<Body>, context, begin, std::min(begin + grain, count));
+            }
+            body(0, grain); // the caller takes the first chunk itself
+            Wait(group);
+        }
+
+    private:
+        static size_t DefaultThreadCount() {
+            const char* threads = std::getenv("GLOO_THREADS");
+            int count = threads != nullptr ? std::atoi(threads) : 0;
+            return count > 0 ? size_t(count) : std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        static const size_t kInitialQueueCapacity = 256;
+
+        struct Slot {
+            void (*run)(void* context, size_t begin, size_t end);
+            void* context;
+            size_t begin;
+            size_t end;
+            TaskGroup* group;
+        };
+
+        // Ring buffer of slots, oldest at `head`; the owner works at the back, thieves at the front.
+        struct WorkQueue {
+            std::mutex mutex;
+            std::vector<Slot> ring = std::vector<Slot>(kInitialQueueCapacity);
+            size_t head = 0;
+            size_t count = 0;
+
+            void PushBack(const Slot& slot) {
+                if (count == ring.size()) {
+                    std::vector<Slot> grown(2 * ring.size());
+                    for (size_t k = 0; k < count; k++) {
+                        grown[k] = ring[(head + k) % ring.size()];
+                    }
+                    ring.swap(grown);
+                    head = 0;
+                }
+                ring[(head + count) % ring.size()] = slot;
+                count++;
+            }
+            Slot PopBack() {
+                count--;
+                return ring[(head + count) % ring.size()];
+            }
+            Slot PopFront() {
+                Slot slot = ring[head];
+                head = (head + 1) % ring.size();
+                count--;
+                return slot;
+            }
+        };
+
+        template <class Body>
+        static void RunRange(void* context, size_t begin, size_t end) {
+            (*static_cast<const Body*>(context))(begin, end);
+        }
+        static void RunBoxed(void* context, size_t, size_t) {
+            std::unique_ptr<Task> task(static_cast<Task*>(context));
+            (*task)();
+        }
+
+        void Push(TaskGroup& group, void (*run)(void*, size_t, size_t), void* context, size_t begin, size_t end) {
+            group.pending_.fetch_add(1);
+            WorkQueue& queue = *queues_[CurrentQueue()];
+            {
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.PushBack(Slot{ run, context, begin, end, &group });
+            }
+            queued_.fetch_add(1);
+            wake_.notify_one();
+        }
+
+        // queue owned by the calling thread; outside threads share queue 0
+        static ThreadPool*& CurrentPool() {
+            static thread_local ThreadPool* pool = nullptr;
+            return pool;
+        }
+        static size_t& CurrentQueueIndex() {
+            static thread_local size_t index = 0;
+            return index;
+        }
+        size_t CurrentQueue() const {
+            return CurrentPool() == this ? CurrentQueueIndex() : 0;
+        }
+
+        bool RunOne(size_t home) {
+            Slot slot;
+            if (!PopOwn(home, slot) && !Steal(home, slot)) {
+                return false;
+            }
+            queued_.fetch_sub(1);
+            slot.run(slot.context, slot.begin, slot.end);
+            slot.group->pending_.fetch_sub(1);
+            return true;
+        }
+
+        bool PopOwn(size_t home, Slot& slot) {
+            WorkQueue& queue = *queues_[home];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.count == 0) {
+                return false;
+            }
+            slot = queue.PopBack();
+            return true;
+        }
+
+        bool Steal(size_t home, Slot& slot) {
+            for (size_t offset = 1; offset < queues_.size(); offset++) {
+                WorkQueue& queue = *queues_[(home + offset) % queues_.size()];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (queue.count > 0) {
+                    slot = queue.PopFront();
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void WorkerLoop(size_t home) {
+            CurrentPool() = this;
+            CurrentQueueIndex() = home;
+            for (;;) {
+                if (RunOne(home)) {
+                    continue;
+                }
+                std::unique_lock<std::mutex> lock(sleep_mutex_);
+                if (stopping_) {
+                    return;
+                }
+                // the timeout covers a notify that lands between the failed pop and this wait
+                wake_.wait_for(lock, std::chrono::milliseconds(1), [this] { return stopping_ || queued_.load() > 0; });
+            }
+        }
+
+        std::vector<std::unique_ptr<WorkQueue>> queues_;
+        std::vector<std::thread> workers_;
+        std::atomic<size_t> queued_{ 0 };
+        std::mutex sleep_mutex_;
+        std::condition_variable wake_;
+        bool stopping_ = false;
+    };
+}  // namespace GLOO
+
+#endif
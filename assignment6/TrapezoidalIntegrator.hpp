@@ -7,15 +7,23 @@
 namespace GLOO {
 template <class TSystem, class TState>
 class TrapezoidalIntegrator : public IntegratorBase<TSystem, TState> {
-  TState Integrate(const TSystem& system,
-                   const TState& state,
-                   float start_time,
-                   float dt) const override {
-    ParticleState f_0 = system.ComputeTimeDerivative(state, start_time);
-    ParticleState f_1 = system.ComputeTimeDerivative(state+dt*f_0, start_time+dt);
-    TState new_state = state + dt/2 * (f_0 + f_1);
-    return new_state;
+  void Integrate(const TSystem& system,
+                 TState& state,
+                 float start_time,
+                 float dt) const override {
+    typename TState::Scalar h = dt; // step in the state's precision
+    system.ComputeTimeDerivative(state, start_time, f_0_);
+    predicted_.AssignScaledSum(state, h, f_0_);
+    system.ComputeTimeDerivative(predicted_, start_time+dt, f_1_);
+    f_0_ += f_1_;
+    f_0_ *= h/2;
+    state += f_0_;
   }
+
+  // scratch states, reused across steps
+  mutable TState f_0_;
+  mutable TState f_1_;
+  mutable TState predicted_;
 };
 }  // namespace GLOO
 
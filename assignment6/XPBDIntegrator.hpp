@@ -0,0 +1,325 @@
+#ifndef XPBD_INTEGRATOR_H_
+#define XPBD_INTEGRATOR_H_
+
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+#include "IntegratorBase.hpp"
+#include "SpringGroup.hpp"
+#include "ThreadPool.hpp"
+
+namespace GLOO {
+// Extended position-based dynamics. Every spring becomes a distance
+// constraint with compliance 1/k and the gas pressure becomes one global
+// volume constraint whose compliance is V0^2/nRT, the inverse of the
+// pressure model's stiffness at the rest volume V0 (the system's rest
+// volume, or the volume at the first step if it has none). Sparse spring
+// groups are greedily graph-colored once per system so each color can be
+// projected in parallel without two constraints touching the same particle.
+// The chordal group connects every pair of particles and would need about
+// one color per particle, so it is projected as one Jacobi batch instead,
+// with each particle's mass split among its chords: every chord reads the
+// same positions, and each particle then gathers its corrections in chord
+// order, so the batch costs two parallel passes per iteration.
+template <class TSystem, class TState>
+class XPBDIntegrator : public IntegratorBase<TSystem, TState> {
+ public:
+  using Scalar = typename TState::Scalar;
+  using Vec3 = glm::vec<3, Scalar>;
+
+  explicit XPBDIntegrator(int iterations = 10, Scalar volume_compliance_scale = Scalar(1))
+      : iterations_(iterations), volume_compliance_scale_(volume_compliance_scale) {
+  }
+
+  void Integrate(const TSystem& system,
+                 TState& state,
+                 float start_time,
+                 float dt) const override {
+    Prepare(system, state);
+    Scalar rest_volume = system.GetRestVolume() > Scalar(0) ? system.GetRestVolume() : measured_volume_;
+    Scalar volume_compliance = volume_compliance_scale_ * rest_volume * rest_volume / system.GetPressureConstant();
+    const std::vector<Scalar>& w = system.GetInverseMasses();
+    const Vec3 g = system.GetGravity();
+    const Scalar b = system.GetDrag();
+    Scalar h = dt;
+
+    // predict positions from external forces (gravity and drag)
+    start_positions_ = state.positions;
+    for (size_t i = 0; i < state.positions.size(); i++) {
+      if (w[i] == Scalar(0)) {
+        state.velocities[i] = Vec3(Scalar(0));
+        continue;
+      }
+      Vec3 v = state.velocities[i] + h * (g - b * w[i] * state.velocities[i]);
+      state.positions[i] = state.positions[i] + h * v;
+    }
+
+    // project constraints, one color at a time
+    lambdas_.assign(rest_lengths_.size(), Scalar(0));
+    batch_.lambdas.assign(batch_.rest_lengths.size(), Scalar(0));
+    volume_lambda_ = Scalar(0);
+    Scalar inv_h2 = Scalar(1) / (h * h);
+    std::vector<Vec3>& p = state.positions;
+    for (int iteration = 0; iteration < iterations_; iteration++) {
+      for (size_t c = 0; c + 1 < color_offsets_.size(); c++) {
+        size_t offset = color_offsets_[c];
+        ThreadPool::GetInstance().ParallelFor(
+            color_offsets_[c + 1] - offset, kGrain, [&](size_t begin, size_t end) {
+              for (size_t k = offset + begin; k < offset + end; k++) {
+                ProjectDistance(k, p, w, inv_h2);
+              }
+            });
+      }
+      ProjectBatch(p, w, inv_h2);
+      ProjectVolume(system, p, w, inv_h2, rest_volume, volume_compliance);
+    }
+
+    // velocities follow from the corrected positions
+    for (size_t i = 0; i < p.size(); i++) {
+      if (w[i] != Scalar(0)) {
+        state.velocities[i] = (p[i] - start_positions_[i]) / h;
+      }
+    }
+  }
+
+ private:
+  static const size_t kGrain = 256;
+  static const size_t kParticleGrain = 1024;
+
+  // Jacobi-projected constraints, with each particle's incident constraints
+  // as compressed rows: entries offsets[i] .. offsets[i + 1] of particle i
+  // are (k << 1) | (i is the second endpoint of constraint k).
+  struct Batch {
+    std::vector<uint32_t> first;
+    std::vector<uint32_t> second;
+    std::vector<Scalar> rest_lengths;
+    std::vector<Scalar> compliances;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> entries;
+    std::vector<Scalar> lambdas;
+    std::vector<Vec3> corrections; // per constraint, lambda change times the unit direction
+  };
+
+  void Prepare(const TSystem& system, const TState& state) const {
+    // (re)build the constraint lists when the system's topology changes; the
+    // stiffness of the volume constraint is read from the system every step
+    if (prepared_for_ == &system && constraint_count_ == system.GetSpringCount() &&
+        particle_count_ == state.positions.size()) {
+      return;
+    }
+    prepared_for_ = &system;
+    constraint_count_ = system.GetSpringCount();
+    particle_count_ = state.positions.size();
+    measured_volume_ = Volume(system, state.positions, nullptr);
+
+    std::vector<uint32_t> first, second, color;
+    std::vector<Scalar> rest, compliance;
+    std::vector<std::vector<uint64_t>> used(state.positions.size()); // per particle bitset of colors
+    size_t color_count = 0;
+    batch_ = Batch();
+    for (const auto& group : system.GetSpringGroups()) {
+      if (group.k == Scalar(0)) {
+        continue; // infinitely compliant: the spring does nothing
+      }
+      if (group.kind == SpringKind::Chordal) {
+        for (size_t s = 0; s < group.size(); s++) {
+          batch_.first.push_back(group.first[s]);
+          batch_.second.push_back(group.second[s]);
+          batch_.rest_lengths.push_back(group.rest_lengths[s]);
+          batch_.compliances.push_back(Scalar(1) / group.k);
+        }
+        continue;
+      }
+      for (size_t s = 0; s < group.size(); s++) {
+        uint32_t i = group.first[s];
+        uint32_t j = group.second[s];
+        size_t c = 0;
+        for (size_t word = 0;; word++) {
+          uint64_t taken = (word < used[i].size() ? used[i][word] : 0) |
+                           (word < used[j].size() ? used[j][word] : 0);
+          if (~taken != 0) {
+            size_t bit = 0;
+            while (taken & (uint64_t(1) << bit)) {
+              bit++;
+            }
+            c = word * 64 + bit;
+            break;
+          }
+        }
+        for (uint32_t end : { i, j }) {
+          if (used[end].size() <= c / 64) {
+            used[end].resize(c / 64 + 1, 0);
+          }
+          used[end][c / 64] |= uint64_t(1) << (c % 64);
+        }
+        color_count = std::max(color_count, c + 1);
+        first.push_back(i);
+        second.push_back(j);
+        rest.push_back(group.rest_lengths[s]);
+        compliance.push_back(Scalar(1) / group.k);
+        color.push_back(uint32_t(c));
+      }
+    }
+
+    // bucket constraints by color so each color is a contiguous range
+    color_offsets_.assign(color_count + 1, 0);
+    for (uint32_t c : color) {
+      color_offsets_[c + 1]++;
+    }
+    for (size_t c = 0; c < color_count; c++) {
+      color_offsets_[c + 1] += color_offsets_[c];
+    }
+    std::vector<size_t> cursor(color_offsets_.begin(), color_offsets_.end() - 1);
+    first_.resize(first.size());
+    second_.resize(first.size());
+    rest_lengths_.resize(first.size());
+    compliances_.resize(first.size());
+    for (size_t k = 0; k < first.size(); k++) {
+      size_t slot = cursor[color[k]]++;
+      first_[slot] = first[k];
+      second_[slot] = second[k];
+      rest_lengths_[slot] = rest[k];
+      compliances_[slot] = compliance[k];
+    }
+
+    // incident batch constraints of each particle, in constraint order
+    batch_.offsets.assign(state.positions.size() + 1, 0);
+    for (size_t k = 0; k < batch_.first.size(); k++) {
+      batch_.offsets[batch_.first[k] + 1]++;
+      batch_.offsets[batch_.second[k] + 1]++;
+    }
+    for (size_t i = 0; i < state.positions.size(); i++) {
+      batch_.offsets[i + 1] += batch_.offsets[i];
+    }
+    std::vector<uint32_t> row_cursor(batch_.offsets.begin(), batch_.offsets.end() - 1);
+    batch_.entries.resize(2 * batch_.first.size());
+    for (uint32_t k = 0; k < batch_.first.size(); k++) {
+      batch_.entries[row_cursor[batch_.first[k]]++] = k << 1;
+      batch_.entries[row_cursor[batch_.second[k]]++] = (k << 1) | 1;
+    }
+    batch_.corrections.resize(batch_.first.size());
+  }
+
+  void ProjectDistance(size_t k, std::vector<Vec3>& p, const std::vector<Scalar>& w, Scalar inv_h2) const {
+    uint32_t i = first_[k];
+    uint32_t j = second_[k];
+    Scalar w_sum = w[i] + w[j];
+    Vec3 d = p[i] - p[j];
+    Scalar l = glm::length(d);
+    if (w_sum == Scalar(0) || l == Scalar(0)) {
+      return;
+    }
+    Scalar alpha = compliances_[k] * inv_h2;
+    Scalar d_lambda = (rest_lengths_[k] - l - alpha * lambdas_[k]) / (w_sum + alpha);
+    lambdas_[k] += d_lambda;
+    Vec3 n = d / l;
+    p[i] += (w[i] * d_lambda) * n;
+    p[j] -= (w[j] * d_lambda) * n;
+  }
+
+  void ProjectBatch(std::vector<Vec3>& p, const std::vector<Scalar>& w, Scalar inv_h2) const {
+    // mass splitting: a particle with n batch constraints acts as n copies of
+    // mass m/n, one per constraint, whose corrections are then averaged
+    const std::vector<uint32_t>& offsets = batch_.offsets;
+    ThreadPool::GetInstance().ParallelFor(batch_.first.size(), kGrain, [&](size_t begin, size_t end) {
+      for (size_t k = begin; k < end; k++) {
+        uint32_t i = batch_.first[k];
+        uint32_t j = batch_.second[k];
+        Scalar w_sum = w[i] * Scalar(offsets[i + 1] - offsets[i]) + w[j] * Scalar(offsets[j + 1] - offsets[j]);
+        Vec3 d = p[i] - p[j];
+        Scalar l = glm::length(d);
+        if (w_sum == Scalar(0) || l == Scalar(0)) {
+          batch_.corrections[k] = Vec3(Scalar(0));
+          continue;
+        }
+        Scalar alpha = batch_.compliances[k] * inv_h2;
+        Scalar d_lambda = (batch_.rest_lengths[k] - l - alpha * batch_.lambdas[k]) / (w_sum + alpha);
+        batch_.lambdas[k] += d_lambda;
+        batch_.corrections[k] = d_lambda / l * d;
+      }
+    });
+    ThreadPool::GetInstance().ParallelFor(p.size(), kParticleGrain, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; i++) {
+        if (w[i] == Scalar(0)) {
+          continue;
+        }
+        Vec3 correction(Scalar(0));
+        for (uint32_t e = offsets[i]; e < offsets[i + 1]; e++) {
+          uint32_t entry = batch_.entries[e];
+          if (entry & 1) {
+            correction -= batch_.corrections[entry >> 1];
+          }
+          else {
+            correction += batch_.corrections[entry >> 1];
+          }
+        }
+        p[i] += w[i] * correction;
+      }
+    });
+  }
+
+  void ProjectVolume(const TSystem& system, std::vector<Vec3>& p, const std::vector<Scalar>& w, Scalar inv_h2,
+                     Scalar rest_volume, Scalar volume_compliance) const {
+    gradients_.assign(p.size(), Vec3(Scalar(0)));
+    Scalar c = Volume(system, p, &gradients_) - rest_volume;
+    Scalar denominator = Scalar(0);
+    for (size_t i = 0; i < p.size(); i++) {
+      denominator += w[i] * glm::dot(gradients_[i], gradients_[i]);
+    }
+    Scalar alpha = volume_compliance * inv_h2;
+    if (denominator + alpha == Scalar(0)) {
+      return;
+    }
+    Scalar d_lambda = (-c - alpha * volume_lambda_) / (denominator + alpha);
+    volume_lambda_ += d_lambda;
+    for (size_t i = 0; i < p.size(); i++) {
+      p[i] += (w[i] * d_lambda) * gradients_[i];
+    }
+  }
+
+  static Scalar Volume(const TSystem& system, const std::vector<Vec3>& p, std::vector<Vec3>* gradients) {
+    // signed volume of the surface (anchored at particle 0) and, optionally, its gradient
+    Scalar volume = Scalar(0);
+    for (glm::vec3 triangle : system.GetTriangles()) {
+      uint32_t a = uint32_t(triangle[0]);
+      uint32_t b = uint32_t(triangle[1]);
+      uint32_t c = uint32_t(triangle[2]);
+      Vec3 ra = p[a] - p[0];
+      Vec3 rb = p[b] - p[0];
+      Vec3 rc = p[c] - p[0];
+      volume += glm::dot(ra, glm::cross(rb, rc)) / Scalar(6);
+      if (gradients) {
+        (*gradients)[a] += glm::cross(rb, rc) / Scalar(6);
+        (*gradients)[b] += glm::cross(rc, ra) / Scalar(6);
+        (*gradients)[c] += glm::cross(ra, rb) / Scalar(6);
+      }
+    }
+    return volume;
+  }
+
+  int iterations_;
+  Scalar volume_compliance_scale_;
+
+  // constraint data derived from the system, built on first use
+  mutable const TSystem* prepared_for_ = nullptr;
+  mutable size_t constraint_count_ = 0;
+  mutable size_t particle_count_ = 0;
+  mutable std::vector<uint32_t> first_;
+  mutable std::vector<uint32_t> second_;
+  mutable std::vector<Scalar> rest_lengths_;
+  mutable std::vector<Scalar> compliances_;
+  mutable std::vector<size_t> color_offsets_;
+  mutable Batch batch_; // the chordal springs
+  mutable Scalar measured_volume_ = Scalar(0); // at the first step, for systems without a rest volume
+
+  // per-step scratch
+  mutable std::vector<Scalar> lambdas_;
+  mutable Scalar volume_lambda_ = Scalar(0);
+  mutable std::vector<Vec3> gradients_;
+  mutable std::vector<Vec3> start_positions_; // positions at the start of the step, for the velocity update
+};
+}  // namespace GLOO
+
+#endif
@@ -3,28 +3,24 @@
 #include <string>
 #include <cstdio>
 #include <stdexcept>
+#include <vector>
 
+// the counting operator new/delete when built with -DGLOO_TRACK_ALLOCATIONS
+#define GLOO_ALLOCATION_TRACKER_IMPLEMENTATION
+#include "AllocationTracker.hpp"
+#include "FramePacer.hpp"
 #include "SimulationApp.hpp"
 #include "IntegratorType.hpp"
 
 using namespace GLOO;
 
-int main(int argc, char** argv) {
-  if (argc != 3) {
-    printf("Usage: %s <e|t|r> <timestep>\n", argv[0]);
-    printf("       e: Integrator: Forward Euler\n");
-    printf("       t: Integrator: Trapezoid\n");
-    printf("       r: Integrator: RK 4\n");
-    printf("\n");
-    printf("Try  : %s t 0.001\n", argv[0]);
-    printf("       for trapezoid (1ms steps)\n");
-    printf("Or   : %s r 0.005\n", argv[0]);
-    printf("       for RK4 (5ms steps)\n");
-    return -1;
-  }
+namespace {
+const int kDefaultMaxFps = 120;
 
+std::unique_ptr<SimulationApp> MakeApp(const std::vector<std::string>& positional) {
+  // single ball from <integrator> <timestep> [mesh.obj]
   IntegratorType integrator_type;
-  switch (argv[1][0]) {
+  switch (positional[0][0]) {
     case 'e':
       integrator_type = IntegratorType::Euler;
       break;
@@ -34,14 +30,71 @@ int main(int argc, char** argv) {
     case 'r':
       integrator_type = IntegratorType::RK4;
       break;
+    case 'x':
+      integrator_type = IntegratorType::XPBD;
+      break;
+    case 'm':
+      integrator_type = IntegratorType::MultiRate;
+      break;
     default:
       throw std::runtime_error(
-          "Unrecognized integrator type: " + std::string(1, argv[1][0]) + ".");
+          "Unrecognized integrator type: " + std::string(1, positional[0][0]) + ".");
+  }
+  float integration_step = std::stof(positional[1]);
+  std::string mesh_path = positional.size() > 2 ? positional[2] : "";
+  return make_unique<SimulationApp>("Assignment3", glm::ivec2(1440, 900),
+                                    integrator_type, integration_step,
+                                    mesh_path);
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::vector<std::string> positional;
+  std::string scenario_path;
+  double max_fps = kDefaultMaxFps;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 10, "--max-fps=") == 0) {
+      max_fps = std::stod(arg.substr(10));
+    } else if (arg.compare(0, 11, "--scenario=") == 0) {
+      scenario_path = arg.substr(11);
+    } else {
+      positional.push_back(arg);
+    }
   }
-  float integration_step = std::stof(argv[2]);
 
-  std::unique_ptr<SimulationApp> app = make_unique<SimulationApp>(
-      "Assignment3", glm::ivec2(1440, 900), integrator_type, integration_step);
+  if (positional.size() < 2 && scenario_path.empty()) {
+    printf("Usage: %s <e|t|r|x|m> <timestep> [mesh.obj] [--max-fps=N]\n", argv[0]);
+    printf("       %s --scenario=<file> [--max-fps=N]\n", argv[0]);
+    printf("       e: Integrator: Forward Euler\n");
+    printf("       t: Integrator: Trapezoid\n");
+    printf("       r: Integrator: RK 4\n");
+    printf("       x: Solver    : XPBD (position-based, stable at frame-rate steps)\n");
+    printf("       m: Integrator: Multi-rate (velocity Verlet, 16 substeps; only gravity per step)\n");
+    printf("\n");
+    printf("Try  : %s t 0.001\n", argv[0]);
+    printf("       for trapezoid (1ms steps)\n");
+    printf("Or   : %s r 0.005\n", argv[0]);
+    printf("       for RK4 (5ms steps)\n");
+    printf("Or   : %s x 0.016\n", argv[0]);
+    printf("       for XPBD (one step per 60Hz frame)\n");
+    printf("Or   : %s x 0.016 sphere.obj\n", argv[0]);
+    printf("       for a soft body built from a closed OBJ mesh\n");
+    printf("\n");
+    printf("--max-fps=N caps the frame rate (default %d, 0 for uncapped)\n",
+           kDefaultMaxFps);
+    printf("--scenario=<file> loads the bodies and ground of a text or compiled\n");
+    printf("                  scenario (see Scenario.hpp) instead\n");
+    return -1;
+  }
+
+  std::unique_ptr<SimulationApp> app;
+  if (!scenario_path.empty()) {
+    app = make_unique<SimulationApp>("Assignment3", glm::ivec2(1440, 900),
+                                     scenario::Load(scenario_path));
+  } else {
+    app = MakeApp(positional);
+  }
 
   app->SetupScene();
 
@@ -50,12 +103,17 @@ int main(int argc, char** argv) {
       std::chrono::time_point<Clock, std::chrono::duration<double>>;
   TimePoint last_tick_time = Clock::now();
   TimePoint start_tick_time = last_tick_time;
+  FramePacer pacer(max_fps);
   while (!app->IsFinished()) {
     TimePoint current_tick_time = Clock::now();
     double delta_time = (current_tick_time - last_tick_time).count();
     double total_elapsed_time = (current_tick_time - start_tick_time).count();
     app->Tick(delta_time, total_elapsed_time);
+    if (AllocationTracker::IsEnabled()) {
+      AllocationTracker::GetInstance().EndFrame();
+    }
     last_tick_time = current_tick_time;
+    pacer.WaitForNextFrame();
   }
   return 0;
 }
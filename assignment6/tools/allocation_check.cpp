@@ -0,0 +1,69 @@
+// Headless allocation check of the step loop. Build it with the tracker on:
+//
+//   g++ -std=c++14 -O2 -pthread -DGLOO_TRACK_ALLOCATIONS -I. -o allocation_check tools/allocation_check.cpp
+//
+// It drops a ball, lets it warm up (first-touch growth of scratch buffers is
+// allowed there), then runs the steady-state steps inside a phase that
+// forbids allocations. It prints the per-phase counts as CSV and exits with 1
+// if the steady-state loop allocated more than the budget (0 by default), so
+// a hot path made allocation-free stays that way. Set GLOO_ALLOCATION_ABORT
+// to abort at the first offending allocation instead, under a debugger.
+#include <cstdio>
+#include <limits>
+#include <string>
+
+#define GLOO_ALLOCATION_TRACKER_IMPLEMENTATION
+#include "../AllocationTracker.hpp"
+#include "../BallSimulation.hpp"
+
+using namespace GLOO;
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printf("Usage: %s <e|t|r|x|m> <timestep> [steps=200] [warmup=20] [subdivisions=3] [budget=0]\n", argv[0]);
+    printf("       budget: allocations allowed per steady-state step\n");
+    return -1;
+  }
+  if (!AllocationTracker::IsEnabled()) {
+    fprintf(stderr, "Built without GLOO_TRACK_ALLOCATIONS; nothing is counted.\n");
+    return -1;
+  }
+  BallParams params;
+  params.integrator = ParseIntegratorType(argv[1]);
+  params.step_size = std::stod(argv[2]);
+  int steps = argc > 3 ? std::stoi(argv[3]) : 200;
+  int warmup = argc > 4 ? std::stoi(argv[4]) : 20;
+  params.subdivisions = argc > 5 ? std::stoi(argv[5]) : 3;
+  double budget = argc > 6 ? std::stod(argv[6]) : 0.0;
+  params.sleep_window = std::numeric_limits<double>::infinity(); // keep stepping
+  params.self_collision = true; // off by default; its per-step hash must not allocate either
+
+  BallSimulation simulation(params);
+  DiagnosticsRecorder diagnostics; // recorded every step while the app's plots are on
+  simulation.SetDiagnostics(&diagnostics);
+  simulation.Drop();
+  for (int n = 0; n < warmup; n++) {
+    simulation.Step(params.step_size);
+  }
+
+  AllocationTracker& tracker = AllocationTracker::GetInstance();
+  tracker.Reset();
+  AllocationCounts start = tracker.GetTotals();
+  for (int n = 0; n < steps; n++) {
+    GLOO_FORBID_ALLOCATIONS("steady-state step");
+    simulation.Step(params.step_size);
+    tracker.EndFrame();
+  }
+  AllocationCounts end = tracker.GetTotals();
+  tracker.Report(stdout);
+
+  double per_step = double(end.allocations - start.allocations) / std::max(steps, 1);
+  printf("steady state: %.2f allocations, %.1f bytes per step (budget %.2f)\n", per_step,
+         double(end.bytes - start.bytes) / std::max(steps, 1), budget);
+  if (per_step > budget) {
+    fprintf(stderr, "FAIL: the step loop allocates %.2f times per step; see the phases above.\n", per_step);
+    return 1;
+  }
+  printf("PASS\n");
+  return 0;
+}
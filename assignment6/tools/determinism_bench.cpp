@@ -0,0 +1,83 @@
+// Headless check of the deterministic execution mode. Runs the same dropped
+// ball in the fast and the deterministic mode on the shared ThreadPool and
+// reports the cost of each together with a hash of the final state's bits.
+// Run it with GLOO_THREADS=1, 2, ... N: the deterministic hash must be the
+// same for every thread count; the fast one generally is not once N > 1.
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "../BallSimulation.hpp"
+
+using namespace GLOO;
+
+namespace {
+struct RunResult {
+  double seconds_per_step;
+  uint64_t hash;
+  std::vector<glm::vec3> positions;
+};
+
+uint64_t HashBits(const std::vector<glm::vec3>& values, uint64_t hash) {
+  // FNV-1a over the raw float bits
+  for (const glm::vec3& value : values) {
+    unsigned char bytes[sizeof(glm::vec3)];
+    std::memcpy(bytes, &value, sizeof(bytes));
+    for (unsigned char byte : bytes) {
+      hash = (hash ^ byte) * 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+RunResult Run(BallParams params, bool deterministic, float duration) {
+  params.deterministic = deterministic;
+  BallSimulation simulation(params);
+  simulation.Drop();
+
+  int steps = int(duration / params.step_size + 0.5);
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int n = 0; n < steps; n++) {
+    simulation.Step(params.step_size);
+  }
+  std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+  RunResult result;
+  result.seconds_per_step = elapsed.count() / std::max(steps, 1);
+  result.positions = simulation.GetState().positions;
+  result.hash = HashBits(simulation.GetState().velocities, HashBits(result.positions, 14695981039346656037ull));
+  return result;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printf("Usage: %s <e|t|r|x|m> <timestep> [seconds=0.5] [subdivisions=3]\n", argv[0]);
+    printf("       Set GLOO_THREADS to choose the thread count.\n");
+    return -1;
+  }
+  BallParams params;
+  params.integrator = ParseIntegratorType(argv[1]);
+  params.step_size = std::stod(argv[2]);
+  params.subdivisions = argc > 4 ? std::stoi(argv[4]) : 3;
+  params.sleep_window = std::numeric_limits<double>::infinity(); // never skip steps while timing
+  float duration = argc > 3 ? std::stof(argv[3]) : 0.5f;
+
+  RunResult fast = Run(params, false, duration);
+  RunResult deterministic = Run(params, true, duration);
+
+  double max_deviation = 0.0;
+  for (size_t i = 0; i < fast.positions.size(); i++) {
+    max_deviation = std::max(max_deviation, double(glm::length(fast.positions[i] - deterministic.positions[i])));
+  }
+  printf("threads %zu\n", ThreadPool::GetInstance().GetThreadCount());
+  printf("mode,us_per_step,state_hash\n");
+  printf("fast,%.3f,%016llx\n", fast.seconds_per_step * 1e6, (unsigned long long)fast.hash);
+  printf("deterministic,%.3f,%016llx\n", deterministic.seconds_per_step * 1e6, (unsigned long long)deterministic.hash);
+  printf("deterministic overhead: %+.1f%%\n", 100.0 * (deterministic.seconds_per_step / fast.seconds_per_step - 1.0));
+  printf("fast vs deterministic max position deviation: %.6e\n", max_deviation);
+  return 0;
+}
@@ -0,0 +1,101 @@
+// Headless level-of-detail check: drops a ball, switches it through several
+// subdivision levels while it falls, and compares it with the same ball left
+// at its constructed level. Every level models the same body, so each switch
+// must keep the total mass and the center-of-mass velocity, and the switched
+// ball's center of mass must follow the reference one. Prints one CSV row per
+// switch and exits with 1 if any of them drifts past the tolerances.
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "../MultiResolutionBall.hpp"
+
+using namespace GLOO;
+
+namespace {
+struct Bulk {
+  double mass = 0.0;
+  glm::dvec3 position = glm::dvec3(0.0); // center of mass
+  glm::dvec3 velocity = glm::dvec3(0.0);
+};
+
+Bulk Measure(const MultiResolutionBall& ball) {
+  Bulk bulk;
+  const std::vector<float>& masses = ball.GetSystem().GetMasses();
+  const ParticleState& state = ball.GetState();
+  for (size_t i = 0; i < masses.size(); i++) {
+    bulk.mass += masses[i];
+    bulk.position += double(masses[i]) * glm::dvec3(state.positions[i]);
+    bulk.velocity += double(masses[i]) * glm::dvec3(state.velocities[i]);
+  }
+  bulk.position /= bulk.mass;
+  bulk.velocity /= bulk.mass;
+  return bulk;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printf("Usage: %s <e|t|r|x|m> <timestep> [subdivisions=2]\n", argv[0]);
+    printf("       Switches the ball up two levels, down to 1 and back while it falls;\n");
+    printf("       the time step must be stable at every level it visits (x 0.004 is).\n");
+    return -1;
+  }
+  BallParams params;
+  params.integrator = ParseIntegratorType(argv[1]);
+  params.step_size = std::stod(argv[2]);
+  params.subdivisions = argc > 3 ? std::stoi(argv[3]) : 2;
+
+  MultiResolutionBall switched(params);
+  MultiResolutionBall reference(params);
+  if (!switched.SupportsLevelChanges()) {
+    fprintf(stderr, "FAIL: this ball has a single level.\n");
+    return 1;
+  }
+  switched.Drop();
+  reference.Drop();
+
+  // every switch lands while the ball is still in the air, so the reference falls the same way
+  const double frame = 1.0 / 60.0;
+  const int frames_per_switch = 4;
+  const std::vector<int> levels = { std::min(params.subdivisions + 1, switched.GetMaxLevel()),
+                                    std::min(params.subdivisions + 2, switched.GetMaxLevel()), 1, params.subdivisions };
+  const double mass_tolerance = 1e-5; // relative
+  const double velocity_tolerance = 1e-4; // m/s
+  const double position_tolerance = 0.01 * params.scale; // m
+
+  const Bulk start = Measure(switched);
+  bool ok = true;
+  printf("frame,from,to,mass_change,velocity_change,position_change,offset_from_reference\n");
+  for (size_t s = 0; s < levels.size(); s++) {
+    for (int f = 0; f < frames_per_switch; f++) {
+      switched.Step(frame);
+      reference.Step(frame);
+    }
+    int from = switched.GetLevel();
+    Bulk before = Measure(switched);
+    switched.SetLevel(levels[s]);
+    Bulk after = Measure(switched);
+    Bulk expected = Measure(reference);
+
+    double mass_change = std::abs(after.mass / start.mass - 1.0);
+    double velocity_change = glm::length(after.velocity - before.velocity);
+    double position_change = glm::length(after.position - before.position);
+    double offset = glm::length(after.position - expected.position);
+    printf("%d,%d,%d,%.3e,%.3e,%.3e,%.3e\n", int((s + 1) * frames_per_switch), from, switched.GetLevel(), mass_change,
+           velocity_change, position_change, offset);
+    if (!(mass_change <= mass_tolerance) || !(velocity_change <= velocity_tolerance) ||
+        !(position_change <= position_tolerance) || !(offset <= position_tolerance)) { // NaN fails too
+      ok = false;
+    }
+  }
+
+  if (!ok) {
+    fprintf(stderr, "FAIL: a level switch changed the mass or the center-of-mass motion (tolerances %.0e relative, "
+                    "%.0e m/s, %.0e m).\n", mass_tolerance, velocity_tolerance, position_tolerance);
+    return 1;
+  }
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,74 @@
+// Headless float vs. double benchmark of the soft-body ball. Runs the same
+// BallSimulation at both precisions, dropped onto the ground plane, and
+// reports throughput alongside the drift of the float run from the double
+// reference.
+#include <chrono>
+#include <cstdio>
+#include <limits>
+#include <string>
+
+#include "../BallSimulation.hpp"
+
+using namespace GLOO;
+
+namespace {
+struct RunResult {
+  double seconds_per_step;
+  double start_volume;
+  double end_volume;
+  std::vector<glm::dvec3> positions;
+};
+
+template <class T>
+RunResult Run(const BallParams& params, float duration) {
+  BallSimulationT<T> simulation(params);
+  simulation.Drop();
+
+  RunResult result;
+  result.start_volume = simulation.GetSystem().GetVolume();
+  int steps = int(duration / params.step_size + 0.5);
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int n = 0; n < steps; n++) {
+    simulation.Step(params.step_size);
+  }
+  std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+  result.seconds_per_step = elapsed.count() / std::max(steps, 1);
+  result.end_volume = simulation.GetSystem().GetVolume();
+
+  const std::vector<glm::vec<3, T>>& positions = simulation.GetState().positions;
+  const std::vector<uint32_t>& order = simulation.GetParticleOrder();
+  result.positions.resize(positions.size());
+  for (size_t i = 0; i < positions.size(); i++) {
+    result.positions[order[i]] = glm::dvec3(positions[i]); // report in construction order
+  }
+  return result;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printf("Usage: %s <e|t|r|x|m> <timestep> [seconds=1] [subdivisions=3] [ordering=none|morton|rcm]\n", argv[0]);
+    return -1;
+  }
+  BallParams params;
+  params.integrator = ParseIntegratorType(argv[1]);
+  params.step_size = std::stod(argv[2]);
+  params.subdivisions = argc > 4 ? std::stoi(argv[4]) : 3;
+  params.ordering = ParseParticleOrdering(argc > 5 ? argv[5] : "none");
+  params.sleep_window = std::numeric_limits<double>::infinity(); // never skip steps while timing
+  float duration = argc > 3 ? std::stof(argv[3]) : 1.f;
+
+  RunResult f = Run<float>(params, duration);
+  RunResult d = Run<double>(params, duration);
+
+  double max_deviation = 0.0;
+  for (size_t i = 0; i < f.positions.size(); i++) {
+    max_deviation = std::max(max_deviation, glm::length(f.positions[i] - d.positions[i]));
+  }
+  printf("precision,us_per_step,volume_drift\n");
+  printf("float,%.3f,%.6e\n", f.seconds_per_step * 1e6, f.end_volume / f.start_volume - 1.0);
+  printf("double,%.3f,%.6e\n", d.seconds_per_step * 1e6, d.end_volume / d.start_volume - 1.0);
+  printf("float vs double max position deviation: %.6e\n", max_deviation);
+  printf("double/float cost ratio: %.2f\n", d.seconds_per_step / f.seconds_per_step);
+  return 0;
+}
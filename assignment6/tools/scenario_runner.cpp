@@ -0,0 +1,142 @@
+// Headless driver for scenario files (see Scenario.hpp). Runs every given
+// scenario, text or compiled, concurrently on the work-stealing ThreadPool
+// and writes one CSV row of metrics per body. `--compile` turns a text
+// scenario into the binary form that loads without parsing.
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../BallSimulation.hpp"
+#include "../Scenario.hpp"
+#include "../SceneStep.hpp"
+#include "../ThreadPool.hpp"
+
+using namespace GLOO;
+
+namespace {
+struct BodyMetrics {
+  glm::dvec3 end_center = glm::dvec3(0.0); // contact-sphere center (mean of the surface particles) at the end of the run
+  double volume_error = 0.0; // max |V / V0 - 1|
+  bool stable = true; // positions stayed finite and bounded
+};
+
+struct RunResult {
+  std::string error; // empty if the scenario loaded and ran
+  double load_seconds = 0.0; // reading the file
+  double build_seconds = 0.0; // constructing the bodies
+  double run_seconds = 0.0;
+  std::vector<BodyMetrics> bodies;
+};
+
+using Clock = std::chrono::high_resolution_clock;
+
+double SecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+RunResult RunScenario(const std::string& filename) {
+  RunResult result;
+  try {
+    auto start = Clock::now();
+    Scenario scenario = scenario::Load(filename);
+    result.load_seconds = SecondsSince(start);
+
+    start = Clock::now();
+    std::vector<std::unique_ptr<BallSimulation>> simulations;
+    std::vector<double> rest_volumes;
+    for (const ScenarioBody& body : scenario.bodies) {
+      if (body.params.mesh.empty()) {
+        simulations.emplace_back(new BallSimulation(body.params, body.start_center));
+      } else {
+        simulations.emplace_back(new BallSimulation(body.params, body.start_center,
+                                                    MeshBodyBuilder<float>::ReadObj(body.params.mesh)));
+      }
+      simulations.back()->SetGround(scenario.ground);
+      if (body.dropped) {
+        simulations.back()->Drop();
+      }
+      rest_volumes.push_back(simulations.back()->GetSystem().GetVolume());
+    }
+    result.build_seconds = SecondsSince(start);
+
+    start = Clock::now();
+    result.bodies.resize(simulations.size());
+    std::vector<BallSimulation*> bodies;
+    for (const std::unique_ptr<BallSimulation>& simulation : simulations) {
+      bodies.push_back(simulation.get());
+    }
+    // the scene step of the sharded runs, so shard_runner --shards=1 matches this output
+    SceneStep step(SceneStep::ExchangeInterval(scenario));
+    for (int frame = 0, frames = SceneStep::FrameCount(scenario); frame < frames; frame++) {
+      step.AdvanceThrough(frame, scenario.frame_rate, bodies);
+      for (size_t b = 0; b < simulations.size(); b++) {
+        BodyMetrics& metrics = result.bodies[b];
+        if (!metrics.stable) {
+          continue;
+        }
+        for (const glm::vec3& position : simulations[b]->GetState().positions) {
+          if (!std::isfinite(position.x) || !std::isfinite(position.y) || !std::isfinite(position.z) ||
+              glm::length(position) > 1e3f) {
+            metrics.stable = false;
+            break;
+          }
+        }
+        metrics.volume_error = std::max(
+            metrics.volume_error, std::abs(simulations[b]->GetSystem().GetVolume() / rest_volumes[b] - 1.0));
+      }
+    }
+    for (size_t b = 0; b < simulations.size(); b++) {
+      // not positions[0]: the center particle hangs free (radial_k 0) and always ends on the ground
+      result.bodies[b].end_center = glm::dvec3(simulations[b]->GetContactSphere().center);
+    }
+    result.run_seconds = SecondsSince(start);
+  } catch (const std::exception& e) {
+    result.error = e.what();
+  }
+  return result;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2 || (std::string(argv[1]) == "--compile" && argc != 4)) {
+    printf("Usage: %s <scenario>...\n", argv[0]);
+    printf("       Runs the scenarios and writes one CSV row per body to stdout.\n");
+    printf("       %s --compile <scenario.txt> <scenario.bin>\n", argv[0]);
+    printf("       Compiles a text scenario to the binary form; keep it beside its source for relative mesh paths.\n");
+    return -1;
+  }
+  if (std::string(argv[1]) == "--compile") {
+    scenario::SaveBinary(scenario::Load(argv[2], false), argv[3]); // mesh paths stay relative to the source
+    return 0;
+  }
+
+  std::vector<std::string> filenames(argv + 1, argv + argc);
+  std::vector<RunResult> results(filenames.size());
+  ThreadPool& pool = ThreadPool::GetInstance();
+  ThreadPool::TaskGroup group;
+  for (size_t s = 0; s < filenames.size(); s++) {
+    pool.Submit(group, [&, s] { results[s] = RunScenario(filenames[s]); });
+  }
+  pool.Wait(group);
+
+  int failures = 0;
+  printf("scenario,body,end_x,end_y,end_z,volume_error,stable,load_seconds,build_seconds,run_seconds\n");
+  for (size_t s = 0; s < filenames.size(); s++) {
+    const RunResult& r = results[s];
+    if (!r.error.empty()) {
+      fprintf(stderr, "%s: %s\n", filenames[s].c_str(), r.error.c_str());
+      failures++;
+      continue;
+    }
+    for (size_t b = 0; b < r.bodies.size(); b++) {
+      const BodyMetrics& m = r.bodies[b];
+      printf("%s,%zu,%.6f,%.6f,%.6f,%.6e,%d,%.6f,%.4f,%.4f\n", filenames[s].c_str(), b, m.end_center.x, m.end_center.y,
+             m.end_center.z, m.volume_error, int(m.stable), r.load_seconds, r.build_seconds, r.run_seconds);
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+// Headless driver for sharded runs (see ShardCoordinator.hpp): simulates the
+// bodies of a scenario in worker processes, collects every frame and writes
+// one CSV row of metrics per body, followed by a hash of the final states.
+// The hash must not change with the shard count (with deterministic solvers,
+// e.g. GLOO_THREADS=1 or `deterministic 1` in the scenario).
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../MeshExporter.hpp"
+#include "../Scenario.hpp"
+#include "../ShardCoordinator.hpp"
+
+using namespace GLOO;
+
+namespace {
+struct BodyMetrics {
+  double volume_error = 0.0; // max |V / V0 - 1|
+  bool stable = true; // positions stayed finite and bounded
+};
+
+uint64_t HashBits(const std::vector<glm::vec3>& values, uint64_t hash) {
+  // FNV-1a over the raw float bits
+  for (const glm::vec3& value : values) {
+    unsigned char bytes[sizeof(glm::vec3)];
+    std::memcpy(bytes, &value, sizeof(bytes));
+    for (unsigned char byte : bytes) {
+      hash = (hash ^ byte) * 1099511628211ull;
+    }
+  }
+  return hash;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  size_t shard_count = 2;
+  std::string scenario_path;
+  std::string export_directory;
+  MeshFormat export_format = MeshFormat::PLY;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 9, "--shards=") == 0) {
+      shard_count = std::stoul(arg.substr(9));
+    } else if (arg.compare(0, 9, "--export=") == 0) {
+      export_directory = arg.substr(9);
+    } else if (arg == "--obj") {
+      export_format = MeshFormat::OBJ;
+    } else {
+      scenario_path = arg;
+    }
+  }
+  if (scenario_path.empty()) {
+    printf("Usage: %s [--shards=N] [--export=<dir> [--obj]] <scenario>\n", argv[0]);
+    printf("       Runs the scenario's bodies in N worker processes (default 2)\n");
+    printf("       and writes one CSV row per body to stdout. --export writes\n");
+    printf("       every collected frame as PLY (or OBJ) files.\n");
+    return -1;
+  }
+
+  std::unique_ptr<ShardCoordinator> sharded;
+  try {
+    sharded.reset(new ShardCoordinator(scenario::Load(scenario_path), shard_count));
+  } catch (const std::exception& e) {
+    fprintf(stderr, "%s: %s\n", scenario_path.c_str(), e.what());
+    return 1;
+  }
+  ShardCoordinator& coordinator = *sharded;
+  auto start = std::chrono::high_resolution_clock::now();
+  coordinator.Start();
+
+  std::unique_ptr<MeshExporter> exporter; // created after the fork: its threads stay in this process
+  if (!export_directory.empty()) {
+    exporter.reset(new MeshExporter(export_directory, export_format));
+  }
+  std::vector<BodyMetrics> metrics(coordinator.GetBodyCount());
+  try {
+    while (coordinator.NextFrame()) {
+      for (size_t b = 0; b < metrics.size(); b++) {
+        const ParticleState& state = coordinator.GetState(b);
+        const ShardCoordinator::BodyFrame& frame = coordinator.GetBodyFrame(b);
+        if (exporter != nullptr) {
+          exporter->Submit("body" + std::to_string(b), coordinator.GetFrame() - 1, state.positions,
+                           coordinator.GetTriangles(b), true);
+        }
+        for (const glm::vec3& position : state.positions) {
+          if (!std::isfinite(position.x) || !std::isfinite(position.y) || !std::isfinite(position.z) ||
+              glm::length(position) > 1e3f) {
+            metrics[b].stable = false;
+            break;
+          }
+        }
+        if (frame.rest_volume > 0.f) {
+          metrics[b].volume_error =
+              std::max(metrics[b].volume_error, std::abs(double(frame.volume) / frame.rest_volume - 1.0));
+        }
+      }
+    }
+    coordinator.Finish();
+  } catch (const std::exception& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  if (exporter != nullptr) {
+    exporter->Flush();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+  uint64_t hash = 14695981039346656037ull;
+  printf("body,shard,particles,end_x,end_y,end_z,volume_error,stable\n");
+  for (size_t b = 0; b < metrics.size(); b++) {
+    const ParticleState& state = coordinator.GetState(b);
+    hash = HashBits(state.velocities, HashBits(state.positions, hash));
+    glm::vec3 center = contact::SurfaceCenter(state.positions); // as scenario_runner reports it
+    printf("%zu,%zu,%zu,%.6f,%.6f,%.6f,%.6e,%d\n", b, coordinator.GetShard(b), state.positions.size(), center.x,
+           center.y, center.z, metrics[b].volume_error, int(metrics[b].stable));
+  }
+  printf("shards %zu, frames %d, exchange every %.4g s, %.2f MB shared, %.3f s, state hash %016llx\n",
+         coordinator.GetShardCount(), coordinator.GetFrame(), coordinator.GetExchangeInterval(),
+         coordinator.GetSharedBytes() / (1024.0 * 1024.0), seconds, (unsigned long long)hash);
+  return 0;
+}
@@ -0,0 +1,57 @@
+// Headless rest-detection check: drops a ball onto the ground, steps it at
+// 60 frames per second and reports when it fell asleep. It prints the kinetic
+// energy and center-of-mass speed every half second as CSV and exits with 1
+// if the ball is still awake after the time limit, so a rest test that the
+// ground response's contact jitter keeps from firing (and with it the sleep
+// path) is caught.
+#include <cstdio>
+#include <string>
+
+#include "../BallSimulation.hpp"
+
+using namespace GLOO;
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printf("Usage: %s <e|t|r|x|m> <timestep> [limit=10] [subdivisions=3]\n", argv[0]);
+    printf("       limit: simulated seconds the ball may take to fall asleep\n");
+    return -1;
+  }
+  BallParams params;
+  params.integrator = ParseIntegratorType(argv[1]);
+  params.step_size = std::stod(argv[2]);
+  double limit = argc > 3 ? std::stod(argv[3]) : 10.0;
+  params.subdivisions = argc > 4 ? std::stoi(argv[4]) : 3;
+
+  BallSimulation simulation(params);
+  simulation.Drop();
+  const double frame = 1.0 / 60.0;
+  const int frames_per_sample = 30;
+  printf("time,kinetic_energy,center_of_mass_speed,asleep\n");
+  int frames = 0;
+  for (; frames * frame < limit && !simulation.IsAsleep(); frames++) {
+    simulation.Step(frame);
+    if ((frames + 1) % frames_per_sample == 0 || simulation.IsAsleep()) {
+      const std::vector<float>& masses = simulation.GetSystem().GetMasses();
+      const std::vector<glm::vec3>& velocities = simulation.GetState().velocities;
+      double kinetic_energy = 0.0;
+      double total_mass = 0.0;
+      glm::dvec3 momentum(0.0);
+      for (size_t i = 0; i < velocities.size(); i++) {
+        kinetic_energy += 0.5 * masses[i] * glm::dot(velocities[i], velocities[i]);
+        momentum += double(masses[i]) * glm::dvec3(velocities[i]);
+        total_mass += masses[i];
+      }
+      printf("%.3f,%.6e,%.6e,%d\n", (frames + 1) * frame, kinetic_energy, glm::length(momentum) / total_mass,
+             int(simulation.IsAsleep()));
+    }
+  }
+  if (!simulation.IsAsleep()) {
+    fprintf(stderr, "FAIL: the ball is still awake after %.2f s (thresholds %.2g J, %.2g m/s over %.2g s).\n", limit,
+            params.sleep_kinetic_energy, params.sleep_speed, params.sleep_window);
+    return 1;
+  }
+  printf("asleep after %.3f s\n", frames * frame);
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,219 @@
+// Parallel parameter sweep over headless BallSimulations. Reads a sweep spec,
+// runs the cartesian product of the listed values concurrently on the
+// work-stealing ThreadPool, and writes one CSV row of metrics per run.
+//
+// Spec format, one entry per line ('#' starts a comment):
+//   duration 2.0              simulated seconds per run
+//   drop_height 1.0           start height of the ball center
+//   frame_rate 60             rate at which metrics are sampled
+//   export ply out/           also write every run's surface per frame
+//                             (ply or obj) as out/run<r>_<frame>.<ext>
+//   <ball param> v1 v2 ...    any BallParams member, e.g. surface_k 20 30 40
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../BallSimulation.hpp"
+#include "../MeshExporter.hpp"
+#include "../ThreadPool.hpp"
+
+using namespace GLOO;
+
+namespace {
+struct SweepAxis {
+  std::string name;
+  std::vector<std::string> values;
+};
+
+struct SweepSpec {
+  double duration = 2.0;
+  double drop_height = 1.0;
+  double frame_rate = 60.0;
+  std::string export_format; // empty: no mesh export
+  std::string export_directory;
+  std::vector<SweepAxis> axes;
+};
+
+struct RunMetrics {
+  double bounce_height = 0.0; // rebound apex: highest gap under the surface particles after the first ground contact (0: no rebound)
+  double volume_error = 0.0; // max |V / V0 - 1|
+  bool stable = true; // positions stayed finite and bounded
+  double sim_seconds = 0.0; // simulated time reached
+  double wall_seconds = 0.0;
+};
+
+SweepSpec ParseSpec(std::istream& in) {
+  SweepSpec spec;
+  BallParams probe;
+  std::string line;
+  while (std::getline(in, line)) {
+    line = line.substr(0, line.find('#'));
+    std::istringstream tokens(line);
+    std::string name;
+    if (!(tokens >> name)) {
+      continue;
+    }
+    std::vector<std::string> values;
+    for (std::string value; tokens >> value;) {
+      values.push_back(value);
+    }
+    if (values.empty()) {
+      throw std::runtime_error("Sweep entry has no values: " + name + ".");
+    }
+    if (name == "duration") {
+      spec.duration = std::stod(values[0]);
+    } else if (name == "drop_height") {
+      spec.drop_height = std::stod(values[0]);
+    } else if (name == "frame_rate") {
+      spec.frame_rate = std::stod(values[0]);
+    } else if (name == "export") {
+      if (values.size() != 2 || (values[0] != "ply" && values[0] != "obj")) {
+        throw std::runtime_error("Expected: export <ply|obj> <directory>.");
+      }
+      spec.export_format = values[0];
+      spec.export_directory = values[1];
+    } else if (SetBallParam(probe, name, values[0])) {
+      spec.axes.push_back({ name, values });
+    } else {
+      throw std::runtime_error("Unrecognized sweep parameter: " + name + ".");
+    }
+  }
+  return spec;
+}
+
+RunMetrics RunOne(size_t run, const BallParams& params, const SweepSpec& spec, MeshExporter* exporter) {
+  RunMetrics metrics;
+  auto start = std::chrono::high_resolution_clock::now();
+
+  BallSimulation simulation(params, glm::vec3(0.f, float(spec.drop_height), 0.f));
+  simulation.Drop();
+  const double rest_volume = simulation.GetSystem().GetVolume();
+  const double frame = 1.0 / spec.frame_rate;
+  bool touched_ground = false; // since the drop
+  const std::string export_name = "run" + std::to_string(run);
+  MeshExporter::Triangles triangles = std::make_shared<const std::vector<glm::vec3>>(simulation.GetTriangles());
+  int frame_index = 0;
+
+  while (metrics.sim_seconds < spec.duration) {
+    simulation.Step(frame);
+    metrics.sim_seconds += frame;
+    if (exporter != nullptr) {
+      // offline: wait for a free slot rather than drop frames
+      exporter->Submit(export_name, frame_index++, simulation.GetState().positions, triangles, true);
+    }
+
+    const std::vector<glm::vec3>& positions = simulation.GetState().positions;
+    double lowest = std::numeric_limits<double>::infinity();
+    for (size_t i = 0; i < positions.size(); i++) {
+      if (!std::isfinite(positions[i].x) || !std::isfinite(positions[i].y) || !std::isfinite(positions[i].z) ||
+          glm::length(positions[i]) > 1e3f) {
+        metrics.stable = false;
+      }
+      if (i > 0 || positions.size() == 1) { // the center particle hangs free (radial_k 0) and rests on the ground
+        lowest = std::min(lowest, double(positions[i].y));
+      }
+    }
+    if (!metrics.stable) {
+      break;
+    }
+    double gap = lowest - simulation.GetGround().height;
+    if (touched_ground) {
+      metrics.bounce_height = std::max(metrics.bounce_height, gap); // stays 0 while the ball is on the ground
+    }
+    touched_ground = touched_ground || gap <= 0.0;
+    metrics.volume_error = std::max(metrics.volume_error, std::abs(simulation.GetSystem().GetVolume() / rest_volume - 1.0));
+  }
+
+  std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+  metrics.wall_seconds = elapsed.count();
+  return metrics;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    printf("Usage: %s <sweep spec file | ->\n", argv[0]);
+    printf("       Writes one CSV row per parameter combination to stdout.\n");
+    return -1;
+  }
+  SweepSpec spec;
+  try {
+    if (std::string(argv[1]) == "-") {
+      spec = ParseSpec(std::cin);
+    } else {
+      std::ifstream file(argv[1]);
+      if (!file) {
+        throw std::runtime_error("Cannot open sweep spec: " + std::string(argv[1]) + ".");
+      }
+      spec = ParseSpec(file);
+    }
+  } catch (const std::exception& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  // expand the cartesian product of all axes
+  std::vector<std::vector<size_t>> combinations(1);
+  for (const SweepAxis& axis : spec.axes) {
+    std::vector<std::vector<size_t>> expanded;
+    for (const std::vector<size_t>& combination : combinations) {
+      for (size_t v = 0; v < axis.values.size(); v++) {
+        expanded.push_back(combination);
+        expanded.back().push_back(v);
+      }
+    }
+    combinations.swap(expanded);
+  }
+
+  std::vector<BallParams> runs(combinations.size());
+  for (size_t r = 0; r < runs.size(); r++) {
+    for (size_t a = 0; a < spec.axes.size(); a++) {
+      SetBallParam(runs[r], spec.axes[a].name, spec.axes[a].values[combinations[r][a]]);
+    }
+  }
+
+  std::unique_ptr<MeshExporter> exporter;
+  if (!spec.export_format.empty()) {
+    exporter.reset(new MeshExporter(spec.export_directory,
+                                    spec.export_format == "ply" ? MeshFormat::PLY : MeshFormat::OBJ, 32,
+                                    std::max(2u, std::thread::hardware_concurrency() / 2)));
+  }
+
+  std::vector<RunMetrics> results(runs.size());
+  ThreadPool& pool = ThreadPool::GetInstance();
+  ThreadPool::TaskGroup group;
+  for (size_t r = 0; r < runs.size(); r++) {
+    pool.Submit(group, [&, r] { results[r] = RunOne(r, runs[r], spec, exporter.get()); });
+  }
+  pool.Wait(group);
+  if (exporter != nullptr) {
+    exporter->Flush();
+    if (exporter->GetFailed() > 0) {
+      fprintf(stderr, "%zu mesh files could not be written to %s\n", exporter->GetFailed(),
+              spec.export_directory.c_str());
+    }
+  }
+
+  printf("run");
+  for (const SweepAxis& axis : spec.axes) {
+    printf(",%s", axis.name.c_str());
+  }
+  printf(",bounce_height,volume_error,stable,sim_seconds,wall_seconds\n");
+  for (size_t r = 0; r < runs.size(); r++) {
+    printf("%zu", r);
+    for (size_t a = 0; a < spec.axes.size(); a++) {
+      printf(",%s", spec.axes[a].values[combinations[r][a]].c_str());
+    }
+    const RunMetrics& m = results[r];
+    printf(",%.6f,%.6e,%d,%.4f,%.4f\n", m.bounce_height, m.volume_error, int(m.stable), m.sim_seconds, m.wall_seconds);
+  }
+  return 0;
+}